@@ -22,11 +22,24 @@
 #include "qem_global.h"
 #include <QMap>
 #include <QObject>
+#include <QVector>
 #include <QVariant>
 #include <QStringList>
 
 QEM_BEGIN_NAMESPACE
 
+/// Named attributes of an object.
+/** \class Attributes attributes.h <qem/attributes.h>
+ * Subclasses may keep well-known attributes in typed fields by implementing
+ * readField(), writeField() and fieldNames(), other attributes are kept in a
+ * flat vector sorted by atom of their names. Both kinds behave same through
+ * the attribute methods.
+ *
+ * Attribute names are interned in a process-wide table by atomOf(), so all
+ * objects share one copy of each name. Names used by the library, such as
+ * "author" and "cover", are interned when the table is created and looked up
+ * without locking.
+ **/
 class QEM_SHARED_EXPORT Attributes : public QObject
 {
     Q_OBJECT
@@ -35,40 +48,27 @@ public:
         QObject(parent)
     {}
 
+    /// Copies all attributes of \a o, subclasses take their fields by adoptFields().
     inline Attributes(const Attributes &o) :
-        QObject(o.parent()), m_attributes(o.m_attributes)
+        QObject(o.parent()), m_attributes(o.allAttributes())
     {}
 
-    inline Attributes& operator= (const Attributes &other)
-    {
-        m_attributes = other.m_attributes;
-        return *this;
-    }
+    virtual ~Attributes();
+
+    Attributes& operator= (const Attributes &other);
 
     /// Returns number of attributes.
-    QEM_INVOKABLE inline int attributeCount() const
-    {
-        return m_attributes.size();
-    }
+    QEM_INVOKABLE int attributeCount() const;
 
     /// Returns names of all attributes.
-    QEM_INVOKABLE inline QStringList attributeNames() const
-    {
-        return QStringList(m_attributes.keys());
-    }
+    QEM_INVOKABLE QStringList attributeNames() const;
 
     /// Returns \c true if contains attribute named \a name.
-    QEM_INVOKABLE inline bool hasAttribute(const QString &name) const
-    {
-        return m_attributes.contains(name);
-    }
+    QEM_INVOKABLE bool hasAttribute(const QString &name) const;
 
     /// Get attribute value by \a name.
-    QEM_INVOKABLE inline QVariant attribute(const QString &name,
-                const QVariant &defaultValue = QVariant()) const
-    {
-        return m_attributes.value(name, defaultValue);
-    }
+    QEM_INVOKABLE QVariant attribute(const QString &name,
+                                     const QVariant &defaultValue = QVariant()) const;
 
     /// Set attribute \a value named \a name.
     QEM_INVOKABLE void setAttribute(const QString &name, const QVariant &value);
@@ -76,12 +76,67 @@ public:
     /// Remove one attribute named \a name.
     QEM_INVOKABLE void removeAttribute(const QString &name);
 
+    /// Returns atom of attribute name \a name.
+    /** If \a name is not interned, interns it when \a create is \c true,
+     * otherwise returns \c -1. It is thread-safe.
+     */
+    static int atomOf(const QString &name, bool create = true);
+
+    /// Returns attribute name of \a atom, or null string if \a atom is invalid.
+    static QString nameOf(int atom);
+
 signals:
     void attributeChanged(const QString &name, const QVariant &value);
     void attributeRemoved(const QString &name);
 
+protected:
+    /// Reads typed field \a name to \a value if not \c 0.
+    /** Returns \c false if the field has no value or \a name is not a field.
+     * The default implementation returns \c false.
+     */
+    virtual bool readField(const QString &name, QVariant *value) const;
+
+    /// Writes \a value to typed field \a name, clears the field if \a value is \c 0.
+    /** Returns \c false if \a name is not a field or type of \a value not matches
+     * the field, then the value is kept in attribute map. The default
+     * implementation returns \c false.
+     */
+    virtual bool writeField(const QString &name, const QVariant *value);
+
+    /// Appends names of typed fields holding values to \a names.
+    virtual void fieldNames(QStringList &names) const;
+
+    /// Moves attributes in map to typed fields.
+    /** Constructors of subclasses need call it after copying attributes. */
+    void adoptFields();
+
 private:
-    QVariantMap m_attributes;
+    struct Entry
+    {
+        int atom;
+        QVariant value;
+    };
+    typedef QVector<Entry> EntryList;
+
+    /// Returns all attributes including typed fields.
+    EntryList allAttributes() const;
+
+    /// Returns index of entry of \a atom, or \c -1 if not found.
+    int indexOf(int atom) const;
+
+    /// Returns index of entry named \a name, or \c -1 if not found.
+    inline int indexOf(const QString &name) const
+    {
+        return indexOf(atomOf(name, false));
+    }
+
+    /// Returns index of first entry in \a list whose atom is not less than \a atom.
+    static int lowerBound(const EntryList &list, int atom);
+
+    /// Sets entry of \a atom in \a list to \a value.
+    static void insert(EntryList &list, int atom, const QVariant &value);
+
+    EntryList m_attributes;     // sorted by atom
 };
 
 QEM_END_NAMESPACE
@@ -25,6 +25,8 @@
 
 QEM_BEGIN_NAMESPACE
 
+class ContentCache;
+
 class QEM_SHARED_EXPORT Book : public Chapter
 {
     Q_OBJECT
@@ -58,23 +60,31 @@ public:
                   QObject *parent = 0);
 
     inline Book(const Part &part) :
-        Chapter(part)
+        Chapter(part), m_fields(0), m_cache(0)
     {
+        adoptFields();
         reset();
     }
 
     inline Book(const Chapter &chapter) :
-        Chapter(chapter)
+        Chapter(chapter), m_fields(0), m_cache(0)
     {
+        adoptFields();
         reset();
     }
 
+    /// Copies attributes and items, the content cache is not shared.
     inline Book(const Book &other):
-        Chapter(other), m_extensions(other.m_extensions)
-    {}
+        Chapter(other), m_fields(0), m_extensions(other.m_extensions), m_cache(0)
+    {
+        adoptFields();
+    }
 
     ~Book();
 
+    /// Copies attributes and items, the content cache is kept.
+    Book& operator =(const Book &other);
+
     QString author() const;
     void setAuthor(const QString &author);
 
@@ -139,6 +149,26 @@ public:
         return m_extensions.size();
     }
 
+    /// Returns cache of decoded text of the book, or \c 0 if caching is disabled.
+    inline ContentCache* contentCache() const
+    {
+        return m_cache;
+    }
+
+    /// Caches decoded text of file objects in the book up to \a maxBytes bytes.
+    /**
+     * The cache is attached to all FileObject children of the book, file objects
+     * created later should be attached by FileObject::setCache().
+     * Set \a maxBytes <= 0 to disable caching.
+     */
+    void setCacheSize(qint64 maxBytes);
+
+protected:
+    // metadata are kept in typed fields
+    virtual bool readField(const QString &name, QVariant *value) const;
+    virtual bool writeField(const QString &name, const QVariant *value);
+    virtual void fieldNames(QStringList &names) const;
+
 #ifdef QEM_QML_TARGET
 signals:
     void authorChanged(const QString &author);
@@ -155,7 +185,22 @@ protected slots:
 #endif
 
 private:
+    enum Field {
+        AuthorField, GenreField, StateField, SubjectField, PublisherField, RightsField,
+        LanguageField, StringFieldCount, DateField = StringFieldCount, NoField
+    };
+
+    /// Returns field of attribute \a name, or \c NoField.
+    static Field fieldOf(const QString &name);
+
+    /// Returns value of string field \a field, or attribute \a key if the field is not set.
+    QString stringField(Field field, const QString &key) const;
+
+    QString m_strings[StringFieldCount];
+    QDate m_date;
+    int m_fields;           // bit of Field set if has value
     ExtensionMap m_extensions;
+    ContentCache *m_cache;
 };
 
 QEM_END_NAMESPACE
@@ -48,14 +48,15 @@ public:
             QObject *parent = 0);
 
     inline Chapter(const Part &part) :
-        Part(part)
-    {}
+        Part(part), m_cover(0), m_hasCover(false), m_hasIntro(false)
+    {
+        adoptFields();
+    }
 
     inline Chapter(const Chapter &other) :
-        Part(other)
+        Part(other), m_cover(0), m_hasCover(false), m_hasIntro(false)
     {
-        setCover(other.cover());
-        setIntro(other.intro());
+        adoptFields();
     }
 
     FileObject* cover() const;
@@ -96,6 +97,12 @@ public:
     QEM_INVOKABLE Chapter* newChapter(const QString &title, FileObject *file,
                                       const QByteArray &codec = QByteArray());
 
+protected:
+    // cover and intro are kept in typed fields
+    virtual bool readField(const QString &name, QVariant *value) const;
+    virtual bool writeField(const QString &name, const QVariant *value);
+    virtual void fieldNames(QStringList &names) const;
+
 #ifdef QEM_QML_TARGET
 signals:
     void coverChanged(FileObjectPointer cover);
@@ -105,6 +112,11 @@ protected slots:
     virtual void fireAttributeRemove(const QString &name);
 #endif
 
+private:
+    FileObject *m_cover;
+    bool m_hasCover;
+    TextObject m_intro;
+    bool m_hasIntro;
 };
 
 QEM_END_NAMESPACE
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QEM_CONTENTCACHE_H
+#define QEM_CONTENTCACHE_H
+
+#include "qem_global.h"
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+
+QEM_BEGIN_NAMESPACE
+
+class FileObject;
+class ContentCachePrivate;
+
+/// Byte-budgeted LRU cache of decoded FileObject text.
+/** \class ContentCache contentcache.h <qem/contentcache.h>
+ * Texts are keyed by FileObject and codec, the least recently used texts are
+ * evicted when the total size exceeds maxBytes(). A FileObject with a cache
+ * set by FileObject::setCache() is looked up by TextObject before decoding.
+ *
+ * All methods are thread-safe.
+ **/
+class QEM_SHARED_EXPORT ContentCache : public QObject
+{
+    Q_OBJECT
+private:
+    Q_DISABLE_COPY(ContentCache)
+public:
+    /// Constructs cache holding at most \a maxBytes bytes of text.
+    explicit ContentCache(qint64 maxBytes, QObject *parent = 0);
+
+    ~ContentCache();
+
+    qint64 maxBytes() const;
+
+    /// Sets memory budget, texts are evicted if the cache is over \a maxBytes.
+    void setMaxBytes(qint64 maxBytes);
+
+    /// Returns bytes of all cached texts.
+    qint64 totalBytes() const;
+
+    /// Finds text of \a file decoded with \a codec.
+    /** Returns \c true and save text to \a text if found. */
+    bool find(const FileObject *file, const QByteArray &codec, QString *text) const;
+
+    /// Caches \a text of \a file decoded with \a codec.
+    /** Text larger than maxBytes() is not cached. */
+    void insert(const FileObject *file, const QByteArray &codec, const QString &text);
+
+    /// Removes cached text of \a file.
+    void remove(const FileObject *file);
+
+    void clear();
+
+    /// Returns number of successful find().
+    quint64 hits() const;
+
+    /// Returns number of failed find().
+    quint64 misses() const;
+
+private:
+    ContentCachePrivate *p;
+};
+
+QEM_END_NAMESPACE
+
+#endif // QEM_CONTENTCACHE_H
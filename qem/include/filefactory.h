@@ -37,17 +37,33 @@ class QEM_SHARED_EXPORT FileFactory
 private:
     FileFactory();
 public:
+    /// Returns FileObject for file \a name in local file system.
+    /** If \a mapped is \c true, the file is mapped into memory once and shared by all
+     * devices from openDevice(), FileObject::mappedData() returns the mapping which is
+     * valid until the FileObject is deleted.
+     */
     static FileObject* getFile(const QString &name, const QString &mime = QString(),
-                               QObject *parent = 0);
+                               QObject *parent = 0, bool mapped = false);
 
     static FileObject* getFile(const QString &name, QIODevice *device,
                                qint64 offset, qint64 size,
                                const QString &mime = QString(),
                               QObject *parent = 0);
 
+    /// Returns FileObject for entry \a name in \a zip.
+    /** The entry index of \a zip is shared by its files, call releaseZip() before
+     * closing or deleting \a zip.
+     */
     static FileObject* getFile(QuaZip *zip, const QString &name, const QString &mime = QString(),
                                QObject *parent = 0);
 
+    /// Forgets the entry index of \a zip.
+    /** Files created from \a zip keep working if the archive was opened by file
+     * name, on a QFile, a mapped file or a QBuffer, they read it by own handles.
+     * Files of an archive on other devices cannot be opened after release.
+     */
+    static void releaseZip(QuaZip *zip);
+
 };
 
 QEM_END_NAMESPACE
@@ -21,12 +21,17 @@
 
 #include "qem_global.h"
 #include <QObject>
+#include <QFuture>
+#include <QPointer>
 #include <QMetaType>
 
 class QIODevice;
+class QThreadPool;
 
 QEM_BEGIN_NAMESPACE
 
+class ContentCache;
+
 /// Provides readable file content.
 /** \class FileObject fileobject.h <qem/fileobject.h>
  * This class provides common ways to read data from file. The data of FileObject
@@ -49,12 +54,12 @@ public:
 
     /// Constructs FileObject object associated with MIME type \a mime.
     explicit inline FileObject(const QString &mime = QString(), QObject *parent = 0) :
-        QObject(parent), m_mime(mime)
+        QObject(parent), m_mime(mime), m_fingerprint(0), m_hasFingerprint(false)
     {}
 
     /// Destroys FileObject object.
-    inline virtual ~FileObject()
-    {}
+    /** The cached text of this object is removed from cache(). */
+    virtual ~FileObject();
 
     /// Returns the name of the object.
     /** The name is commonly base name of a file. */
@@ -80,7 +85,10 @@ public:
     { return -1; }
 
     /// Reads all available data from the file content.
-    /** This method use openDevice(), so make sure openDevice() return availabe IO device. */
+    /** This method use openDevice(), so make sure openDevice() return availabe IO device.
+     * If available() is known the result is allocated once. Returns empty array
+     * if the content is larger than \c INT_MAX bytes.
+     */
     virtual QByteArray readAll();
 
     /// Copies \a size bytes to IO device \a out.
@@ -91,8 +99,70 @@ public:
      * Returns copied bytes number or \c -1 if occurs errors.
      **/
     virtual qint64 copyTo(QIODevice &out, qint64 size = -1);
+
+    /// Reads at most \a maxSize bytes at \a offset of file content to \a data.
+    /** Returns number of bytes read or \c -1 if occurs errors.
+     *
+     * Unlike openDevice(), this method not changes any shared position, the file
+     * and area objects created by FileFactory can be read from multiple threads.
+     *
+     * The default implementation seeks the device from openDevice(), a sequential
+     * device, such as a compressed ZIP entry, is read forward to \a offset.
+     **/
+    virtual qint64 readAt(qint64 offset, char *data, qint64 maxSize);
+
+    /// Reads at most \a size bytes at \a offset of file content.
+    /** \a size is clamped to \c INT_MAX, the most bytes a QByteArray holds. */
+    QByteArray readAt(qint64 offset, qint64 size);
+
+    /// Returns file content mapped in memory, or \c 0 if the content is not mapped.
+    /** The size of data is available(), the data is valid until the object is
+     * deleted. The default implementation returns \c 0.
+     */
+    virtual const char* mappedData();
+
+    /// Reads all available data in the I/O thread pool.
+    /**
+     * The future reports progress in bytes when available() is known and may be
+     * canceled, a canceled future has no result. A future fails without result
+     * if occurs errors or the content is larger than \c INT_MAX bytes. The object
+     * must not be deleted before the future finished.
+     * \sa ioThreadPool()
+     */
+    QFuture<QByteArray> readAllAsync();
+
+    /// Copies \a size bytes to IO device \a out in the I/O thread pool.
+    /**
+     * The result is number of copied bytes or \c -1 if occurs errors. \a out
+     * is written from the pool thread, it must not be used before the future
+     * finished. Progress and cancellation are same as readAllAsync().
+     */
+    QFuture<qint64> copyToAsync(QIODevice *out, qint64 size = -1);
+
+    /// Returns 64-bit fingerprint of file content.
+    /**
+     * The content is hashed by FileUtils::fingerprint() on first call and the
+     * result is kept, so changes of the underlying file are not noticed. It may
+     * be called from multiple threads. Equal fingerprints do not guarantee equal contents.
+     */
+    quint64 fingerprint();
+
+    /// Returns the thread pool running asynchronous reads of all file objects.
+    /** Use QThreadPool::setMaxThreadCount() to bound the number of I/O threads. */
+    static QThreadPool* ioThreadPool();
+
+    /// Returns cache of decoded text for this object, or \c 0 if not cached.
+    inline ContentCache* cache() const
+    { return m_cache; }
+
+    /// Sets cache of decoded text to \a cache.
+    /** Cached text in the old cache is removed. Set \c 0 to disable caching. */
+    void setCache(ContentCache *cache);
 private:
     QString m_mime;
+    QPointer<ContentCache> m_cache;
+    quint64 m_fingerprint;
+    bool m_hasFingerprint;
 };
 
 typedef FileObject * FileObjectPointer;
@@ -32,6 +32,7 @@ class QuaZip;
 class QIODevice;
 class QDataStream;
 class QTextStream;
+class QTextCodec;
 
 QEM_BEGIN_NAMESPACE
 
@@ -58,6 +59,12 @@ public:
      */
     static QString mimeType(const QString &name);
 
+    /// Returns codec for \a name from a registry shared by all threads.
+    /** Codecs are looked up by Qt once per name. Returns \c 0 if \a name is empty
+     * or the codec is not found, callers choose their own fallback.
+     */
+    static QTextCodec* codecForName(const QByteArray &name);
+
     /// Copy \a size bytes data from \a in to \a out.
     /** Returns copied bytes number.
      * \param in The readable input QIODevice.
@@ -98,6 +105,36 @@ public:
      */
     static qint64 copy(QTextStream &in, QTextStream &out, qint64 size = -1);
 
+    /// Computes 64-bit FNV-1a hash of \a size bytes from \a in.
+    /** The data is hashed by chunks. If \a size < 0 hash all available data. */
+    static quint64 fingerprint(QIODevice &in, qint64 size = -1);
+
+    /// Computes 64-bit FNV-1a hash of \a data.
+    static quint64 fingerprint(const QByteArray &data);
+
+    /// Computes 64-bit FNV-1a hash of UTF-16 characters of \a text.
+    /** The characters are hashed as little-endian bytes on all platforms. */
+    static quint64 fingerprint(const QString &text);
+
+    /// Continues fingerprint \a hash of preceding text with \a text.
+    /** Hashing text by chunks gives same result as fingerprint(const QString&) of whole text. */
+    static quint64 fingerprint(quint64 hash, const QString &text);
+
+    /// Reads at most \a maxSize bytes at \a offset of \a device to \a data.
+    /** Returns number of bytes read or \c -1 if occurs errors.
+     *
+     * The position of \a device is not changed, so different parts of one device
+     * can be read from multiple threads.
+     * \param device The random-access device, a writable file must be flushed.
+     */
+    static qint64 readAt(QIODevice &device, qint64 offset, char *data, qint64 maxSize);
+
+    /// Returns \c true if \a a and \a b have same bytes.
+    /** They are compared in one pass over their devices by chunks, devices may be
+     * sequential, such as compressed ZIP entries.
+     */
+    static bool sameContent(FileObject &a, FileObject &b);
+
     /// Read bytes from ZIP archive.
     static QByteArray readZipData(QuaZip &zip, const QString &entryName,
                                   const char *password = 0);
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QEM_LINEREADER_H
+#define QEM_LINEREADER_H
+
+#include "qem_global.h"
+#include <QString>
+
+QEM_BEGIN_NAMESPACE
+
+/// Pull-style reader of text lines.
+/** \class LineReader linereader.h <qem/linereader.h>
+ * Lines are split by CR LF, CR or LF like TextObject::lines(), but only the
+ * current chunk of text is kept in memory. Subclasses supply text by chunks
+ * in readChunk().
+ *
+ * Use TextObject::lineReader() or Part::lineReader() to read lines of content.
+ **/
+class QEM_SHARED_EXPORT LineReader
+{
+private:
+    Q_DISABLE_COPY(LineReader)
+public:
+    /// Constructs reader of lines in \a text.
+    /** \a text may be raw data not owned by the reader, it must live longer
+     * than the reader, lines read are always copied.
+     */
+    explicit LineReader(const QString &text = QString(), bool skipEmptyLine = false);
+
+    virtual ~LineReader();
+
+    /// Reads next line without line feed to \a line.
+    /** The line owns its data. Returns \c false if no more lines. */
+    bool readLine(QString &line);
+
+protected:
+    /// Returns next chunk of text, an empty string means end of text.
+    /** The default implementation returns empty string. */
+    virtual QString readChunk();
+
+private:
+    /// Appends next chunk to buffer, returns \c false at end of text.
+    bool fill();
+
+    QString m_buffer;
+    int m_pos;
+    bool m_atEnd, m_done, m_skipEmptyLine;
+};
+
+QEM_END_NAMESPACE
+
+#endif // QEM_LINEREADER_H
@@ -32,6 +32,7 @@ class QIODevice;
 QEM_BEGIN_NAMESPACE
 
 class PartPrivate;
+class LineReader;
 
 class QEM_SHARED_EXPORT Part : public Attributes, public QList<Part*>
 {
@@ -39,6 +40,7 @@ class QEM_SHARED_EXPORT Part : public Attributes, public QList<Part*>
 #ifdef QEM_QML_TARGET
     Q_PROPERTY(QString title READ title WRITE setTitle NOTIFY titleChanged)
     Q_PROPERTY(int depth READ depth)
+    Q_PROPERTY(int descendantCount READ descendantCount)
     Q_PROPERTY(int size READ size NOTIFY sizeChanged)
     Q_PROPERTY(QString content READ content)
     Q_PROPERTY(QStringList lines READ lines)
@@ -46,6 +48,28 @@ class QEM_SHARED_EXPORT Part : public Attributes, public QList<Part*>
 
 private:
     PartPrivate *p;
+
+    /// Recomputes depth from sub-parts.
+    void updateDepth();
+
+    /// Applies change of descendant count \a delta and depth to parts listing self.
+    /** \a oldDepth is depth of self before the change. */
+    void treeChanged(int delta, int oldDepth);
+
+    /// Registers self as owner of \a part appended or inserted and updates aggregates.
+    void subPartAdded(Part *part);
+
+    /// Unregisters self as owner of \a parts removed from the list and updates aggregates.
+    void subPartsRemoved(const QList<Part*> &parts);
+
+    /// Drops cached stats of self and parts listing self.
+    void dropStats();
+
+    /// Drops cached stats of parts listing self.
+    void dropOwnerStats();
+
+    /// Moves entries of self from \a old title in title indexes of parts listing self.
+    void moveTitleEntries(const QString &old);
 protected:
     static const QString TITLE_KEY;
 public:
@@ -60,6 +84,12 @@ public:
 
     Part(const QString &title, const TextObject &source, QObject *parent = 0);
 
+    /// Copies attributes, content and sub-part list of \a other.
+    /**
+     * Content is implicitly shared with \a other until either part changes it,
+     * sub-parts are listed by both parts. Identity, owners and the title index
+     * belong to each part and are not copied.
+     */
     Part(const Part &other);
 
     virtual ~Part();
@@ -73,8 +103,32 @@ public:
 
     virtual QString content() const;
 
+    /// Returns the text object holding content.
+    /** Compare sources to find same content without decoding. */
+    const TextObject& source() const;
+
+    /// Returns at most \a maxChars leading characters of content.
+    /** \sa TextObject::preview() */
+    QEM_INVOKABLE virtual QString preview(int maxChars) const;
+
+    /// Returns statistics of content, or sum of all sub-parts for a section.
+    /**
+     * The sum of a section is cached, and dropped with caches of parts listing
+     * it when its tree or text of a part in its tree is changed.
+     * \sa TextObject::stats()
+     */
+    virtual TextStats stats() const;
+
+    /// Returns fingerprint of content, or of fingerprints of all sub-parts for a section.
+    /** \sa TextObject::fingerprint() */
+    virtual quint64 fingerprint() const;
+
     virtual QStringList lines(bool skipEmptyLine = false) const;
 
+    /// Returns new reader of content lines, the caller need delete it.
+    /** \sa TextObject::lineReader() */
+    virtual LineReader* lineReader(bool skipEmptyLine = false) const;
+
     QEM_INVOKABLE virtual qint64 writeTo(QTextStream &out, qint64 size = -1) const;
 
     QEM_INVOKABLE virtual qint64 writeTo(QIODevice &out, const QByteArray &encoding = QByteArray(),
@@ -91,8 +145,32 @@ public:
     QEM_INVOKABLE virtual void setFile(FileObject *file, const QByteArray &codec = QByteArray());
 
     /// Returns depth of sub-parts tree.
+    /**
+     * The depth and descendantCount() are kept by each part and take constant
+     * time. Every change of the list by the methods below updates the part and
+     * then each part listing it, up to the roots, so a change costs time linear
+     * to the depth of listings above the part. A part listed by several parts,
+     * such as sub-parts of a copied part, updates all of them. Changes made through
+     * QList methods not overridden here, such as operator[]() or a QList<Part*>
+     * reference, are not tracked. It is safe to call from several threads while
+     * the tree is not changed.
+     */
     int depth() const;
 
+    /// Returns number of all parts in sub-parts tree, excluding self.
+    QEM_INVOKABLE int descendantCount() const;
+
+    /// Returns the part listing self, or \c 0.
+    /**
+     * If listed by several parts, returns the first one still listing self. When
+     * a listed part is deleted it removes itself from lists listing it.
+     */
+    Part* owner() const;
+
+    /// Returns revision of sub-parts tree.
+    /** It is changed by any change of the tree, including trees of its sub-parts. */
+    int treeRevision() const;
+
     /// Return \c true if has sub-parts, otherwise \c false.
     QEM_INVOKABLE inline bool isSection() const
     { return size() != 0; }
@@ -123,10 +201,67 @@ public:
     /// Insert \a part before index \a i and set its parent to self.
     QEM_INVOKABLE void put(int i, Part* part);
 
+    // QList methods changing the list, keep owners and cached aggregates updated
+
+    inline void append(Part *part)
+    { add(part); }
+
+    inline void prepend(Part *part)
+    { put(0, part); }
+
+    inline void insert(int i, Part *part)
+    { put(i, part); }
+
+    inline void replace(int i, Part *part)
+    { set(i, part); }
+
+    inline void removeAt(int i)
+    { remove(i); }
+
+    inline void removeFirst()
+    { remove(0); }
+
+    inline void removeLast()
+    { remove(size() - 1); }
+
+    Part* takeAt(int i);
+
+    inline Part* takeFirst()
+    { return takeAt(0); }
+
+    inline Part* takeLast()
+    { return takeAt(size() - 1); }
+
+    bool removeOne(Part *part);
+
+    int removeAll(Part *part);
+
+    void clear();
+
+    /// Enables or disables hashed index of sub-part titles.
+    /**
+     * With the index indexOf() and countOf() by title take constant time on
+     * average. The index is built when enabled and kept updated by every change
+     * of the list: add() and newPart() add an entry, put(), remove() and other
+     * insertions or removals shift indexes after the position. Changing title of
+     * a sub-part moves its entries in indexes of parts listing it only. Changes
+     * made through QList methods not overridden here are not tracked. Lookups
+     * are safe to call from several threads while the list and titles are not
+     * changed.
+     */
+    void setTitleIndexEnabled(bool enabled);
+
+    /// Returns \c true if the title index is enabled.
+    bool isTitleIndexEnabled() const;
+
     /// Index sub-part by its \a title begin index \a from.
     /** Returns index in self or \c -1 if not found. */
     QEM_INVOKABLE int indexOf(const QString &title, int from = 0) const;
 
+    /// Returns number of sub-parts with \a title.
+    /** A result greater than \c 1 means duplicate titles. */
+    QEM_INVOKABLE int countOf(const QString &title) const;
+
     /// Index sub-part with Filter begin index \a from.
     /** Returns index in self or \c -1 if not found.
      * \param filter Filter sub-parts, \see Filter.
@@ -168,6 +303,12 @@ public:
     /// Call all clean works and clear cleaner list.
     void cleanup();
 
+protected:
+    // title is kept in typed field
+    virtual bool readField(const QString &name, QVariant *value) const;
+    virtual bool writeField(const QString &name, const QVariant *value);
+    virtual void fieldNames(QStringList &names) const;
+
 #ifdef QEM_QML_TARGET
 signals:
     void titleChanged(const QString &title);
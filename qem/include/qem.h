@@ -54,7 +54,10 @@ public:
     static Book* readBook(const QString &name, const QString &format = QString(),
                           const QVariantMap &args = QVariantMap(), QString *error = 0);
 
-    /** The caller should delete returned Book. */
+    /** The caller should delete returned Book.
+     * Set \c cache_size in \a args to cache decoded text up to the number of bytes,
+     * see Book::setCacheSize().
+     */
     static Book* readBook(QIODevice &device, const QString &format = QString(),
                           const QVariantMap &args = QVariantMap(), QString *error = 0);
 
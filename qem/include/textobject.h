@@ -22,6 +22,7 @@
 #include "fileobject.h"
 #include <QObject>
 #include <QMetaType>
+#include <QSharedDataPointer>
 #include <QStringList>
 
 class QTextStream;
@@ -29,13 +30,43 @@ class QIODevice;
 
 QEM_BEGIN_NAMESPACE
 
+class LineReader;
 class TextObjectPrivate;
 
+/// Statistics of text content.
+struct TextStats
+{
+    /// Number of UTF-16 characters.
+    qint64 chars;
+    /// Number of lines split like TextObject::lines().
+    qint64 lines;
+    /// Number of words, each CJK character is a word.
+    qint64 words;
+    /// Stored size in bytes, file size or memory of string, \c -1 if unknown.
+    qint64 bytes;
+
+    inline TextStats() : chars(0), lines(0), words(0), bytes(0)
+    {}
+
+    inline TextStats& operator +=(const TextStats &other)
+    {
+        chars += other.chars;
+        lines += other.lines;
+        words += other.words;
+        bytes = (bytes < 0 || other.bytes < 0) ? -1 : bytes + other.bytes;
+        return *this;
+    }
+};
+
+/// Text content from string or FileObject.
+/** TextObject is implicitly shared, copies share the same data until one of
+ * them is modified, so passing it by value or through QVariant is cheap.
+ */
 class QEM_SHARED_EXPORT TextObject : public QObject
 {
     Q_OBJECT
 private:
-    TextObjectPrivate *p;
+    QSharedDataPointer<TextObjectPrivate> p;
 public:
     /// Get TextObject from QVariant \a v.
     /**
@@ -54,14 +85,52 @@ public:
 
     TextObject& operator =(const TextObject &other);
 
+    /// Returns \c true if the text contents are equal.
+    /** Strings are compared directly. Contents of files are compared by
+     * fingerprint() first. When the fingerprints are equal, files in same codec
+     * are compared by bytes, others by text.
+     */
     bool operator ==(const TextObject &other) const;
 
+    /// Returns 64-bit fingerprint of text content.
+    /**
+     * The content is hashed by FileUtils::fingerprint() in one pass on first
+     * call, the result is kept until the text is changed. Keep the value after
+     * loading and compare it later to find changed text. Changes of the
+     * underlying file are not noticed.
+     */
+    quint64 fingerprint() const;
+
     /// Returns text content.
     QString text() const;
 
+    /// Returns text content without copy if possible.
+    /** UTF-16LE content of a file mapped in memory, such as chapters of TXT
+     * books, is returned as a view of the mapping without copy and decoding.
+     * The view is valid only while the FileObject lives, copy it before
+     * keeping it longer. Other content is returned as text().
+     */
+    QString textView() const;
+
+    /// Returns at most \a maxChars leading characters of text content.
+    /** File content is decoded only as far as needed. */
+    QString preview(int maxChars) const;
+
+    /// Returns statistics of text content.
+    /** Counted in one pass without loading whole file content, the result is
+     * kept until the text is changed.
+     */
+    TextStats stats() const;
+
     /// Returns lines of text content split by line feed.
     QStringList lines(bool skipEmptyLine = false) const;
 
+    /// Returns new reader of lines in text content.
+    /** File content is decoded by chunks. The caller need delete the reader
+     * after using, and the TextObject must live longer than the reader.
+     */
+    LineReader* lineReader(bool skipEmptyLine = false) const;
+
     /// Writes \a size chararcters text content to QTextStream \a out.
     /** Returns copied characters number or \c -1 if occurs errors. */
     qint64 writeTo(QTextStream &out, qint64 size = -1) const;
@@ -80,6 +149,20 @@ public:
     QByteArray codec() const;
 
     void setFile(FileObject *file, const QByteArray &codec = QByteArray());
+
+    /// Returns global budget in bytes of decoded text kept by file-backed TextObjects.
+    /** It is \c 0 by default, so no text is kept. */
+    static int cacheBudget();
+
+    /// Sets global budget of decoded text to \a bytes, \c 0 disables keeping text.
+    /** Least recently used texts are released when new text needs room or the
+     * budget is lowered. Text of files having a ContentCache is kept by the
+     * cache only.
+     */
+    static void setCacheBudget(int bytes);
+
+    /// Returns bytes of decoded text kept by all TextObjects.
+    static int cachedBytes();
 };
 
 QEM_END_NAMESPACE
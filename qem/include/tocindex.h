@@ -0,0 +1,105 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QEM_TOCINDEX_H
+#define QEM_TOCINDEX_H
+
+#include "qem_global.h"
+#include <QList>
+
+QEM_BEGIN_NAMESPACE
+
+class Part;
+class TocIndexPrivate;
+
+/// Flattened preorder index of sub-parts tree of a part.
+/** \class TocIndex tocindex.h <qem/tocindex.h>
+ * All parts under the root are kept in a contiguous array in preorder, the
+ * position of a part in the array is its ordinal. Parts are addressed by
+ * ordinal in constant time, by path in logarithmic time, and leaf parts
+ * (chapters) are numbered globally for navigation.
+ *
+ * The index is built on demand, and rebuilt on next query after
+ * Part::treeRevision() of the root is changed. Changes by QList methods not
+ * overridden by Part are not tracked, call rebuild() after them.
+ **/
+class QEM_SHARED_EXPORT TocIndex
+{
+    Q_DISABLE_COPY(TocIndex)
+public:
+    /// Indexed part.
+    struct Entry
+    {
+        Part *part;
+        int parent;     ///< ordinal of parent, \c -1 for sub-parts of root
+        int depth;      ///< \c 0 for sub-parts of root
+        int index;      ///< index in parent
+        int end;        ///< ordinal after last descendant
+    };
+
+    /// Constructs index of sub-parts tree of \a root.
+    explicit TocIndex(const Part *root);
+
+    ~TocIndex();
+
+    const Part* root() const;
+
+    /// Returns \c true if the tree is changed after last build.
+    bool isStale() const;
+
+    /// Builds the index again.
+    void rebuild();
+
+    /// Returns number of parts in the tree, excluding root.
+    int size() const;
+
+    /// Returns entry at \a ordinal.
+    const Entry& entry(int ordinal) const;
+
+    /// Returns part at \a ordinal, or \c 0 if \a ordinal is out of range.
+    Part* part(int ordinal) const;
+
+    /// Returns indexes of part at \a ordinal from root, as Part::findPart() accepts.
+    QList<int> path(int ordinal) const;
+
+    /// Returns ordinal of part with \a path, or \c -1 if not found.
+    /** Indexes in \a path must be not negative. */
+    int ordinalOf(const QList<int> &path) const;
+
+    /// Returns ordinal of \a part, or \c -1 if not in the tree.
+    int ordinalOf(const Part *part) const;
+
+    /// Returns number of leaf parts.
+    int chapterCount() const;
+
+    /// Returns ordinal of the \a n-th leaf part, or \c -1 if \a n is out of range.
+    int chapterAt(int n) const;
+
+    /// Returns ordinal of first leaf part after \a ordinal, or \c -1 if not found.
+    int nextChapter(int ordinal) const;
+
+    /// Returns ordinal of last leaf part before \a ordinal, or \c -1 if not found.
+    int previousChapter(int ordinal) const;
+
+private:
+    TocIndexPrivate *p;
+};
+
+QEM_END_NAMESPACE
+
+#endif // QEM_TOCINDEX_H
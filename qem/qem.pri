@@ -21,6 +21,9 @@ HEADERS += \
     include/chapter.h \
     include/book.h \
     include/attributes.h \
+    include/contentcache.h \
+    include/linereader.h \
+    include/tocindex.h \
     include/formats/umd.h \
     include/formats/txt.h \
     include/formats/pmab.h \
@@ -28,6 +31,9 @@ HEADERS += \
     include/formats/all.h \
     include/formats/epub.h \
     src/formats/epub/writer.h \
+    src/devicereader.h \
+    src/linesplitter.h \
+    src/textcounter.h \
     $$PWD/include/utils.h
 
 SOURCES += \
@@ -40,12 +46,18 @@ SOURCES += \
     src/chapter.cpp \
     src/book.cpp \
     src/attributes.cpp \
+    src/contentcache.cpp \
+    src/linereader.cpp \
+    src/tocindex.cpp \
     src/formats/umd.cpp \
     src/formats/txt.cpp \
     src/formats/pmab.cpp \
     src/formats/jar.cpp \
     src/formats/epub.cpp \
     src/formats/epub/writer.cpp \
+    src/devicereader.cpp \
+    src/linesplitter.cpp \
+    src/textcounter.cpp \
     $$PWD/src/utils.cpp
 
 RESOURCES += \
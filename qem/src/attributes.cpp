@@ -19,29 +19,245 @@
 #include <attributes.h>
 #include <fileobject.h>
 #include <textobject.h>
+#include <QHash>
+#include <QReadWriteLock>
 
 QEM_BEGIN_NAMESPACE
 
+// names used by the library and formats, interned when the table is created
+static const char *const KNOWN_NAMES[] = {
+    "title", "cover", "intro", "author", "genre", "state", "subject", "date",
+    "publisher", "rights", "language", "vendor", "isbn", "uuid", "source_path",
+    "source_format", "content_id", 0
+};
+
+struct AtomTable
+{
+    AtomTable();
+
+    // well-known names, never changed after creation so read without lock
+    QHash<QString, int> knownAtoms;
+    QVector<QString> knownNames;
+
+    QReadWriteLock lock;
+    QHash<QString, int> atoms;
+    QVector<QString> names;     // indexed by atom
+};
+
+AtomTable::AtomTable()
+{
+    for (int atom = 0; KNOWN_NAMES[atom] != 0; ++atom) {
+        const QString name(QLatin1String(KNOWN_NAMES[atom]));
+        knownAtoms.insert(name, atom);
+        knownNames.append(name);
+        atoms.insert(name, atom);
+        names.append(name);
+    }
+}
+
+Q_GLOBAL_STATIC(AtomTable, atomTable)
+
+int Attributes::atomOf(const QString &name, bool create)
+{
+    AtomTable *table = atomTable();
+    QHash<QString, int>::const_iterator known = table->knownAtoms.constFind(name);
+    if (known != table->knownAtoms.constEnd()) {
+        return known.value();
+    }
+    {
+        QReadLocker locker(&table->lock);
+        QHash<QString, int>::const_iterator i = table->atoms.constFind(name);
+        if (i != table->atoms.constEnd()) {
+            return i.value();
+        }
+    }
+    if (! create) {
+        return -1;
+    }
+    QWriteLocker locker(&table->lock);
+    // may be interned by other thread
+    QHash<QString, int>::const_iterator i = table->atoms.constFind(name);
+    if (i != table->atoms.constEnd()) {
+        return i.value();
+    }
+    int atom = table->names.size();
+    table->names.append(name);
+    table->atoms.insert(name, atom);
+    return atom;
+}
+
+QString Attributes::nameOf(int atom)
+{
+    AtomTable *table = atomTable();
+    if (atom >= 0 && atom < table->knownNames.size()) {
+        return table->knownNames.at(atom);
+    }
+    QReadLocker locker(&table->lock);
+    return table->names.value(atom);
+}
+
+Attributes::~Attributes()
+{}
+
+Attributes& Attributes::operator= (const Attributes &other)
+{
+    m_attributes = other.allAttributes();
+    QStringList names;
+    fieldNames(names);
+    foreach (const QString &name, names) {
+        writeField(name, 0);
+    }
+    adoptFields();
+    return *this;
+}
+
+int Attributes::attributeCount() const
+{
+    QStringList names;
+    fieldNames(names);
+    return m_attributes.size() + names.size();
+}
+
+QStringList Attributes::attributeNames() const
+{
+    QStringList names;
+    fieldNames(names);
+    for (EntryList::const_iterator i = m_attributes.constBegin(); i != m_attributes.constEnd(); ++i) {
+        names.append(nameOf(i->atom));
+    }
+    names.sort();
+    return names;
+}
+
+bool Attributes::hasAttribute(const QString &name) const
+{
+    return readField(name, 0) || indexOf(name) != -1;
+}
+
+QVariant Attributes::attribute(const QString &name, const QVariant &defaultValue) const
+{
+    QVariant value;
+    if (readField(name, &value)) {
+        return value;
+    }
+    int index = indexOf(name);
+    return index != -1 ? m_attributes.at(index).value : defaultValue;
+}
+
 void Attributes::setAttribute(const QString &name, const QVariant &value)
 {
-    const QVariant &old = m_attributes.value(name);
+    const QVariant &old = attribute(name);
     if (old.canConvert<TextObject>() && value.canConvert<TextObject>()) {
-        if (old.value<TextObject>() == value.value<TextObject>()) {
+        // keeps new file even if content is same
+        const TextObject &a = old.value<TextObject>(), &b = value.value<TextObject>();
+        if (a.file() == b.file() && a == b) {
             return;
         }
     } else if (value == old) {
         return;
     }
-    m_attributes.insert(name, value);
+    if (writeField(name, &value)) {
+        int index = indexOf(name);
+        if (index != -1) {
+            m_attributes.remove(index);
+        }
+    } else {
+        writeField(name, 0);
+        insert(m_attributes, atomOf(name), value);
+    }
     emit attributeChanged(name, value);
 }
 
 void Attributes::removeAttribute(const QString &name)
 {
-    if (m_attributes.contains(name)) {
-        m_attributes.remove(name);
+    bool had = readField(name, 0);
+    writeField(name, 0);
+    int index = indexOf(name);
+    if (index != -1) {
+        m_attributes.remove(index);
+        had = true;
+    }
+    if (had) {
         emit attributeRemoved(name);
     }
 }
 
+bool Attributes::readField(const QString &, QVariant *) const
+{
+    return false;
+}
+
+bool Attributes::writeField(const QString &, const QVariant *)
+{
+    return false;
+}
+
+void Attributes::fieldNames(QStringList &) const
+{}
+
+void Attributes::adoptFields()
+{
+    int index = 0;
+    while (index < m_attributes.size()) {
+        const Entry &entry = m_attributes.at(index);
+        if (writeField(nameOf(entry.atom), &entry.value)) {
+            m_attributes.remove(index);
+        } else {
+            ++index;
+        }
+    }
+}
+
+Attributes::EntryList Attributes::allAttributes() const
+{
+    QStringList names;
+    fieldNames(names);
+    if (names.isEmpty()) {
+        return m_attributes;
+    }
+    EntryList all(m_attributes);
+    foreach (const QString &name, names) {
+        QVariant value;
+        readField(name, &value);
+        insert(all, atomOf(name), value);
+    }
+    return all;
+}
+
+int Attributes::indexOf(int atom) const
+{
+    if (atom < 0) {
+        return -1;
+    }
+    int index = lowerBound(m_attributes, atom);
+    return (index < m_attributes.size() && m_attributes.at(index).atom == atom) ? index : -1;
+}
+
+int Attributes::lowerBound(const EntryList &list, int atom)
+{
+    int low = 0, high = list.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (list.at(middle).atom < atom) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void Attributes::insert(EntryList &list, int atom, const QVariant &value)
+{
+    int index = lowerBound(list, atom);
+    if (index < list.size() && list.at(index).atom == atom) {
+        list[index].value = value;
+    } else {
+        Entry entry;
+        entry.atom = atom;
+        entry.value = value;
+        list.insert(index, entry);
+    }
+}
+
 QEM_END_NAMESPACE
@@ -17,6 +17,7 @@
  */
 
 #include <book.h>
+#include <contentcache.h>
 
 QEM_BEGIN_NAMESPACE
 
@@ -30,7 +31,7 @@ const QString Book::RIGHTS_KEY("rights");
 const QString Book::LANGUAGE_KEY("language");
 
 Book::Book(const QString &title, const QString &author, QObject *parent) :
-    Chapter(title, "", 0, TextObject(), parent)
+    Chapter(title, "", 0, TextObject(), parent), m_fields(0), m_cache(0)
 {
     reset();
     setAuthor(author);
@@ -41,6 +42,31 @@ Book::~Book()
     clearItems();
 }
 
+Book& Book::operator =(const Book &other)
+{
+    // fields are taken by Attributes, the cache is owned by other
+    Chapter::operator =(other);
+    m_extensions = other.m_extensions;
+    return *this;
+}
+
+void Book::setCacheSize(qint64 maxBytes)
+{
+    if (maxBytes <= 0) {
+        delete m_cache;     // file objects hold guarded pointers
+        m_cache = 0;
+        return;
+    }
+    if (0 == m_cache) {
+        m_cache = new ContentCache(maxBytes, this);
+    } else {
+        m_cache->setMaxBytes(maxBytes);
+    }
+    foreach (FileObject *file, findChildren<FileObject*>()) {
+        file->setCache(m_cache);
+    }
+}
+
 void Book::reset()
 {
     setAuthor("");
@@ -53,12 +79,105 @@ void Book::reset()
     setLanguage("");
 }
 
-QString Book::author() const
+Book::Field Book::fieldOf(const QString &name)
 {
-    const QVariant & v = attribute(AUTHOR_KEY);
+    if (AUTHOR_KEY == name) {
+        return AuthorField;
+    } else if (GENRE_KEY == name) {
+        return GenreField;
+    } else if (STATE_KEY == name) {
+        return StateField;
+    } else if (SUBJECT_KEY == name) {
+        return SubjectField;
+    } else if (DATE_KEY == name) {
+        return DateField;
+    } else if (PUBLISHER_KEY == name) {
+        return PublisherField;
+    } else if (RIGHTS_KEY == name) {
+        return RightsField;
+    } else if (LANGUAGE_KEY == name) {
+        return LanguageField;
+    }
+    return NoField;
+}
+
+QString Book::stringField(Field field, const QString &key) const
+{
+    if (m_fields & (1 << field)) {
+        return m_strings[field];
+    }
+    const QVariant & v = attribute(key);
     Q_ASSERT(v.type() == QVariant::String);
     return v.toString();
 }
+
+bool Book::readField(const QString &name, QVariant *value) const
+{
+    Field field = fieldOf(name);
+    if (NoField == field) {
+        return Chapter::readField(name, value);
+    }
+    if (0 == (m_fields & (1 << field))) {
+        return false;
+    }
+    if (value != 0) {
+        if (DateField == field) {
+            *value = m_date;
+        } else {
+            *value = m_strings[field];
+        }
+    }
+    return true;
+}
+
+bool Book::writeField(const QString &name, const QVariant *value)
+{
+    Field field = fieldOf(name);
+    if (NoField == field) {
+        return Chapter::writeField(name, value);
+    }
+    if (0 == value) {
+        if (DateField == field) {
+            m_date = QDate();
+        } else {
+            m_strings[field].clear();
+        }
+        m_fields &= ~(1 << field);
+        return true;
+    }
+    if (DateField == field) {
+        if (value->type() != QVariant::Date) {
+            return false;
+        }
+        m_date = value->toDate();
+    } else {
+        if (value->type() != QVariant::String) {
+            return false;
+        }
+        m_strings[field] = value->toString();
+    }
+    m_fields |= 1 << field;
+    return true;
+}
+
+void Book::fieldNames(QStringList &names) const
+{
+    static const QString* const keys[] = {
+        &AUTHOR_KEY, &GENRE_KEY, &STATE_KEY, &SUBJECT_KEY, &PUBLISHER_KEY, &RIGHTS_KEY,
+        &LANGUAGE_KEY, &DATE_KEY
+    };
+    Chapter::fieldNames(names);
+    for (int field = 0; field < NoField; ++field) {
+        if (m_fields & (1 << field)) {
+            names.append(*keys[field]);
+        }
+    }
+}
+
+QString Book::author() const
+{
+    return stringField(AuthorField, AUTHOR_KEY);
+}
 void Book::setAuthor(const QString &author)
 {
     setAttribute(AUTHOR_KEY, author);
@@ -66,9 +185,7 @@ void Book::setAuthor(const QString &author)
 
 QString Book::genre() const
 {
-    const QVariant & v = attribute(GENRE_KEY);
-    Q_ASSERT(v.type() == QVariant::String);
-    return v.toString();
+    return stringField(GenreField, GENRE_KEY);
 }
 void Book::setGenre(const QString &genre)
 {
@@ -77,9 +194,7 @@ void Book::setGenre(const QString &genre)
 
 QString Book::state() const
 {
-    const QVariant & v = attribute(STATE_KEY);
-    Q_ASSERT(v.type() == QVariant::String);
-    return v.toString();
+    return stringField(StateField, STATE_KEY);
 }
 void Book::setState(const QString &state)
 {
@@ -88,9 +203,7 @@ void Book::setState(const QString &state)
 
 QString Book::subject() const
 {
-    const QVariant & v = attribute(SUBJECT_KEY);
-    Q_ASSERT(v.type() == QVariant::String);
-    return v.toString();
+    return stringField(SubjectField, SUBJECT_KEY);
 }
 void Book::setSubject(const QString &subject)
 {
@@ -99,6 +212,9 @@ void Book::setSubject(const QString &subject)
 
 QDate Book::date() const
 {
+    if (m_fields & (1 << DateField)) {
+        return m_date;
+    }
     return attribute(DATE_KEY).toDate();
 }
 void Book::setDate(const QDate &date)
@@ -108,9 +224,7 @@ void Book::setDate(const QDate &date)
 
 QString Book::publisher() const
 {
-    const QVariant & v = attribute(PUBLISHER_KEY);
-    Q_ASSERT(v.type() == QVariant::String);
-    return v.toString();
+    return stringField(PublisherField, PUBLISHER_KEY);
 }
 void Book::setPublisher(const QString &publisher)
 {
@@ -119,9 +233,7 @@ void Book::setPublisher(const QString &publisher)
 
 QString Book::rights() const
 {
-    const QVariant & v = attribute(RIGHTS_KEY);
-    Q_ASSERT(v.type() == QVariant::String);
-    return v.toString();
+    return stringField(RightsField, RIGHTS_KEY);
 }
 void Book::setRights(const QString &rights)
 {
@@ -130,9 +242,7 @@ void Book::setRights(const QString &rights)
 
 QString Book::language() const
 {
-    const QVariant & v = attribute(LANGUAGE_KEY);
-    Q_ASSERT(v.type() == QVariant::String);
-    return v.toString();
+    return stringField(LanguageField, LANGUAGE_KEY);
 }
 void Book::setLanguage(const QString &language)
 {
@@ -26,7 +26,7 @@ const QString Chapter::INTRO_KEY("intro");
 
 Chapter::Chapter(const QString &title, const QString &text, const FileObject *cover,
                  const TextObject &intro, QObject *parent) :
-    Part(title, text, parent)
+    Part(title, text, parent), m_cover(0), m_hasCover(false), m_hasIntro(false)
 {
     setCover(cover);
     setIntro(intro);
@@ -34,7 +34,7 @@ Chapter::Chapter(const QString &title, const QString &text, const FileObject *co
 
 Chapter::Chapter(const QString &title, FileObject *file, const QByteArray &codec,
                  const FileObject *cover, const TextObject &intro, QObject *parent) :
-    Part(title, file, codec, parent)
+    Part(title, file, codec, parent), m_cover(0), m_hasCover(false), m_hasIntro(false)
 {
     setCover(cover);
     setIntro(intro);
@@ -42,7 +42,7 @@ Chapter::Chapter(const QString &title, FileObject *file, const QByteArray &codec
 
 Chapter::Chapter(const QString &title, const TextObject &source, const FileObject *cover,
                  const TextObject &intro, QObject *parent) :
-    Part(title, source, parent)
+    Part(title, source, parent), m_cover(0), m_hasCover(false), m_hasIntro(false)
 {
     setCover(cover);
     setIntro(intro);
@@ -50,6 +50,9 @@ Chapter::Chapter(const QString &title, const TextObject &source, const FileObjec
 
 FileObject* Chapter::cover() const
 {
+    if (m_hasCover) {
+        return m_cover;
+    }
     return FileObject::fromQVariant(attribute(COVER_KEY));
 }
 void Chapter::setCover(const FileObject *cover)
@@ -59,6 +62,9 @@ void Chapter::setCover(const FileObject *cover)
 
 TextObject Chapter::intro() const
 {
+    if (m_hasIntro) {
+        return m_intro;
+    }
     return TextObject::fromQVariant(attribute(INTRO_KEY));
 }
 void Chapter::setIntro(const TextObject &intro)
@@ -66,11 +72,74 @@ void Chapter::setIntro(const TextObject &intro)
     setAttribute(INTRO_KEY, QVariant::fromValue(intro));
 }
 
+bool Chapter::readField(const QString &name, QVariant *value) const
+{
+    if (COVER_KEY == name) {
+        if (! m_hasCover) {
+            return false;
+        }
+        if (value != 0) {
+            *value = QVariant::fromValue(m_cover);
+        }
+        return true;
+    } else if (INTRO_KEY == name) {
+        if (! m_hasIntro) {
+            return false;
+        }
+        if (value != 0) {
+            *value = QVariant::fromValue(m_intro);
+        }
+        return true;
+    }
+    return Part::readField(name, value);
+}
+
+bool Chapter::writeField(const QString &name, const QVariant *value)
+{
+    if (COVER_KEY == name) {
+        if (0 == value) {
+            m_cover = 0;
+            m_hasCover = false;
+            return true;
+        }
+        if (value->userType() != qMetaTypeId<FileObjectPointer>()) {
+            return false;
+        }
+        m_cover = value->value<FileObjectPointer>();
+        m_hasCover = true;
+        return true;
+    } else if (INTRO_KEY == name) {
+        if (0 == value) {
+            m_intro = TextObject();
+            m_hasIntro = false;
+            return true;
+        }
+        if (value->userType() != qMetaTypeId<TextObject>()) {
+            return false;
+        }
+        m_intro = value->value<TextObject>();
+        m_hasIntro = true;
+        return true;
+    }
+    return Part::writeField(name, value);
+}
+
+void Chapter::fieldNames(QStringList &names) const
+{
+    Part::fieldNames(names);
+    if (m_hasCover) {
+        names.append(COVER_KEY);
+    }
+    if (m_hasIntro) {
+        names.append(INTRO_KEY);
+    }
+}
+
 Chapter* Chapter::newChapter(const QString &title, const QString &text)
 {
     Chapter *chapter = new Chapter(title, text, 0, TextObject(), this);
     Q_ASSERT(chapter != 0);
-    append(chapter);
+    add(chapter);
     return chapter;
 }
 
@@ -78,7 +147,7 @@ Chapter* Chapter::newChapter(const QString &title, FileObject *file, const QByte
 {
     Chapter *chapter = new Chapter(title, file, codec, 0, TextObject(), this);
     Q_ASSERT(chapter != 0);
-    append(chapter);
+    add(chapter);
     return chapter;
 }
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <contentcache.h>
+#include <QCache>
+#include <QMutex>
+#include <climits>
+
+QEM_BEGIN_NAMESPACE
+
+class ContentCachePrivate
+{
+    friend class ContentCache;
+private:
+    struct Entry
+    {
+        QByteArray codec;
+        QString text;
+    };
+
+    /// Cost of text in QCache, QCache counts in int.
+    static inline int cost(const QString &text)
+    {
+        return text.size() * int(sizeof(QChar));
+    }
+
+    static inline int limit(qint64 maxBytes)
+    {
+        return int(qBound(qint64(0), maxBytes, qint64(INT_MAX)));
+    }
+
+    inline ContentCachePrivate(qint64 maxBytes) :
+        cache(limit(maxBytes)), hits(0), misses(0)
+    {}
+
+    QCache<const FileObject*, Entry> cache;
+    mutable QMutex mutex;
+    mutable quint64 hits, misses;
+};
+
+ContentCache::ContentCache(qint64 maxBytes, QObject *parent) :
+    QObject(parent), p(new ContentCachePrivate(maxBytes))
+{}
+
+ContentCache::~ContentCache()
+{
+    delete p;
+}
+
+qint64 ContentCache::maxBytes() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->cache.maxCost();
+}
+
+void ContentCache::setMaxBytes(qint64 maxBytes)
+{
+    QMutexLocker locker(&p->mutex);
+    p->cache.setMaxCost(ContentCachePrivate::limit(maxBytes));
+}
+
+qint64 ContentCache::totalBytes() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->cache.totalCost();
+}
+
+bool ContentCache::find(const FileObject *file, const QByteArray &codec, QString *text) const
+{
+    QMutexLocker locker(&p->mutex);
+    // QCache::object() marks the entry as most recently used
+    ContentCachePrivate::Entry *entry = p->cache.object(file);
+    if (0 == entry || entry->codec != codec) {
+        ++p->misses;
+        return false;
+    }
+    ++p->hits;
+    if (text != 0) {
+        *text = entry->text;
+    }
+    return true;
+}
+
+void ContentCache::insert(const FileObject *file, const QByteArray &codec, const QString &text)
+{
+    ContentCachePrivate::Entry *entry = new ContentCachePrivate::Entry;
+    entry->codec = codec;
+    entry->text = text;
+    QMutexLocker locker(&p->mutex);
+    // deletes the entry if it costs more than maxBytes()
+    p->cache.insert(file, entry, ContentCachePrivate::cost(text));
+}
+
+void ContentCache::remove(const FileObject *file)
+{
+    QMutexLocker locker(&p->mutex);
+    p->cache.remove(file);
+}
+
+void ContentCache::clear()
+{
+    QMutexLocker locker(&p->mutex);
+    p->cache.clear();
+}
+
+quint64 ContentCache::hits() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->hits;
+}
+
+quint64 ContentCache::misses() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->misses;
+}
+
+QEM_END_NAMESPACE
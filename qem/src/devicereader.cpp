@@ -0,0 +1,159 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "devicereader.h"
+#include <QFile>
+#include <QMutex>
+#include <QBuffer>
+#include <QThread>
+#include <QtDebug>
+#include <cstring>
+
+QEM_BEGIN_NAMESPACE
+
+Q_GLOBAL_STATIC(QMutex, sharedDeviceMutex)
+
+QMutex DeviceHandles::s_mutex;
+QHash<QIODevice*, DeviceHandles*> DeviceHandles::s_pools;
+
+DeviceHandles::DeviceHandles(QIODevice *device, const QString &path) :
+    m_device(device), m_path(path), m_ref(1)
+{}
+
+DeviceHandles::~DeviceHandles()
+{
+    qDeleteAll(m_idle);
+}
+
+DeviceHandles* DeviceHandles::acquire(QIODevice *device)
+{
+    QFile *file = qobject_cast<QFile*>(device);
+    if (0 == file || file->fileName().isEmpty()) {
+        return 0;
+    }
+    QMutexLocker locker(&s_mutex);
+    DeviceHandles *pool = s_pools.value(device);
+    // the device may be reopened with other name
+    if (pool != 0 && pool->m_path == file->fileName()) {
+        ++pool->m_ref;
+        return pool;
+    }
+    pool = new DeviceHandles(device, file->fileName());
+    s_pools.insert(device, pool);
+    return pool;
+}
+
+void DeviceHandles::deref()
+{
+    QMutexLocker locker(&s_mutex);
+    if (--m_ref == 0) {
+        if (s_pools.value(m_device) == this) {
+            s_pools.remove(m_device);
+        }
+        delete this;
+    }
+}
+
+QFile* DeviceHandles::checkout()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (! m_idle.isEmpty()) {
+            return m_idle.takeLast();
+        }
+    }
+    QFile *handle = new QFile(m_path);
+    if (! handle->open(QFile::ReadOnly | QFile::Unbuffered)) {
+        qWarning() << "Cannot duplicate file handle:" << m_path;
+        delete handle;
+        return 0;
+    }
+    return handle;
+}
+
+void DeviceHandles::checkin(QFile *handle)
+{
+    QMutexLocker locker(&m_mutex);
+    // keep one idle handle per core at most
+    if (m_idle.size() < qMax(QThread::idealThreadCount(), 1)) {
+        m_idle.append(handle);
+    } else {
+        delete handle;
+    }
+}
+
+DeviceReader::DeviceReader(QIODevice *device) :
+    m_device(device), m_buffer(0), m_handles(0), m_file(0)
+{
+    Q_ASSERT(device != 0);
+    m_buffer = qobject_cast<QBuffer*>(device);
+    if (0 == m_buffer) {
+        m_handles = DeviceHandles::acquire(device);
+    }
+}
+
+DeviceReader::~DeviceReader()
+{
+    if (m_file != 0) {
+        m_handles->checkin(m_file);
+    }
+    if (m_handles != 0) {
+        m_handles->deref();
+    }
+}
+
+qint64 DeviceReader::readAt(qint64 offset, char *data, qint64 maxSize)
+{
+    if (offset < 0 || maxSize < 0) {
+        return -1;
+    }
+    if (m_buffer != 0) {
+        const QByteArray &ba = m_buffer->data();
+        if (offset >= ba.size()) {
+            return 0;
+        }
+        qint64 n = qMin(maxSize, ba.size() - offset);
+        std::memcpy(data, ba.constData() + offset, n);
+        return n;
+    }
+    if (m_handles != 0 && 0 == m_file) {
+        m_file = m_handles->checkout();
+        if (0 == m_file) {      // read the device under lock
+            m_handles->deref();
+            m_handles = 0;
+        }
+    }
+    if (m_file != 0) {
+        if (! m_file->seek(offset)) {
+            qWarning() << "Cannot seek file:" << m_file->fileName();
+            return -1;
+        }
+        return m_file->read(data, maxSize);
+    }
+    QMutexLocker locker(sharedDeviceMutex());
+    qint64 old = m_device->pos();
+    if (! m_device->seek(offset)) {
+        qWarning() << "Cannot seek IO device";
+        return -1;
+    }
+    qint64 n = m_device->read(data, maxSize);
+    m_device->seek(old);
+    return n;
+}
+
+QEM_END_NAMESPACE
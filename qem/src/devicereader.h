@@ -0,0 +1,103 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QEM_DEVICEREADER_H
+#define QEM_DEVICEREADER_H
+
+#include <qem_global.h>
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+class QFile;
+class QBuffer;
+class QIODevice;
+
+QEM_BEGIN_NAMESPACE
+
+/// Read-only handles of a file device opened by file name, shared by its readers.
+/**
+ * Handles are opened when no idle one is left and kept for reuse while the
+ * pool is referenced, so objects reading one file for a long time, such as
+ * areas of a file, should hold a reference by acquire().
+ */
+class DeviceHandles
+{
+public:
+    /// Returns referenced pool of \a device, or \c 0 if it is not a file with name.
+    static DeviceHandles* acquire(QIODevice *device);
+
+    void deref();
+
+    /// Takes an idle handle or opens new one, returns \c 0 if the file cannot be opened.
+    QFile* checkout();
+
+    /// Returns \a handle taken by checkout() to the pool.
+    void checkin(QFile *handle);
+
+private:
+    DeviceHandles(QIODevice *device, const QString &path);
+
+    ~DeviceHandles();
+
+    Q_DISABLE_COPY(DeviceHandles)
+    QIODevice *m_device;
+    QString m_path;
+    int m_ref;      // guarded by s_mutex
+    QMutex m_mutex;
+    QList<QFile*> m_idle;
+
+    static QMutex s_mutex;
+    static QHash<QIODevice*, DeviceHandles*> s_pools;
+};
+
+/// Reads a random-access device by position without moving its cursor.
+/**
+ * A QFile is read through a handle of its DeviceHandles, taken on first read
+ * and returned when the reader is destroyed, a QBuffer is read from its data
+ * directly. Other devices fall back to seek and read under a global lock,
+ * restoring the old position afterwards, they must not be used by others
+ * while read by readers.
+ *
+ * Data written to a writable file is seen after the file is flushed, the
+ * reader never flushes the device. Several readers of one device may be used
+ * from different threads, but one reader must not be shared between threads.
+ */
+class DeviceReader
+{
+public:
+    explicit DeviceReader(QIODevice *device);
+    ~DeviceReader();
+
+    /// Reads at most \a maxSize bytes at \a offset of the device to \a data.
+    /** Returns number of bytes read or \c -1 if occurs errors. */
+    qint64 readAt(qint64 offset, char *data, qint64 maxSize);
+
+private:
+    Q_DISABLE_COPY(DeviceReader)
+    QIODevice *m_device;
+    QBuffer *m_buffer;
+    DeviceHandles *m_handles;
+    QFile *m_file;      // taken from m_handles
+};
+
+QEM_END_NAMESPACE
+
+#endif // QEM_DEVICEREADER_H
@@ -19,15 +19,200 @@
 #include <filefactory.h>
 #include <fileutils.h>
 #include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QHash>
+#include <QThread>
 #include <QBuffer>
 #include <QtDebug>
 #include <QIODevice>
 #include <quazipfile.h>
+#include <cstring>
+#include <climits>
+#include "devicereader.h"
 
 QEM_BEGIN_NAMESPACE
 
 namespace file_object_impl {
 
+    // *********************
+    // ** FileMapping
+    // *********************
+
+    /// Read-only memory mapping of a file shared by its readers.
+    /** The mapping is released when the last reference dropped. */
+    class FileMapping
+    {
+    public:
+        /// Maps file \a path, returns \c 0 if the file cannot be mapped.
+        static FileMapping* create(const QString &path);
+
+        /// Returns mapping of at least \a minSize bytes of file \a path shared by all callers.
+        /** Returns \c 0 if the file cannot be mapped or is shorter than \a minSize. */
+        static FileMapping* shared(const QString &path, qint64 minSize);
+
+        inline const char* data() const
+        {
+            return m_data;
+        }
+
+        inline qint64 size() const
+        {
+            return m_size;
+        }
+
+        inline QString fileName() const
+        {
+            return m_file.fileName();
+        }
+
+        inline void ref()
+        {
+            m_ref.ref();
+        }
+
+        void deref();
+
+    private:
+        inline FileMapping(const QString &path) :
+            m_file(path), m_data(""), m_size(0), m_ref(1), m_shared(false)
+        {}
+
+        inline ~FileMapping()
+        {
+            m_file.close();     // also unmaps the data
+        }
+
+    private:
+        QFile m_file;
+        const char *m_data;
+        qint64 m_size;
+        QAtomicInt m_ref;
+        bool m_shared;
+
+        static QMutex s_mutex;
+        static QHash<QString, FileMapping*> s_shared;
+    };
+
+    QMutex FileMapping::s_mutex;
+    QHash<QString, FileMapping*> FileMapping::s_shared;
+
+    FileMapping* FileMapping::create(const QString &path)
+    {
+        FileMapping *mapping = new FileMapping(path);
+        if (! mapping->m_file.open(QFile::ReadOnly)) {
+            qWarning() << "Cannot open file for mapping:" << path;
+            delete mapping;
+            return 0;
+        }
+        mapping->m_size = mapping->m_file.size();
+        if (mapping->m_size > 0) {
+            uchar *data = mapping->m_file.map(0, mapping->m_size);
+            if (0 == data) {
+                qWarning() << "Cannot map file:" << path << mapping->m_file.errorString();
+                delete mapping;
+                return 0;
+            }
+            mapping->m_data = reinterpret_cast<const char*>(data);
+        }
+        return mapping;
+    }
+
+    FileMapping* FileMapping::shared(const QString &path, qint64 minSize)
+    {
+        QMutexLocker locker(&s_mutex);
+        FileMapping *mapping = s_shared.value(path);
+        if (mapping != 0 && mapping->m_size >= minSize) {
+            mapping->ref();
+            return mapping;
+        }
+        // not mapped or the file grew, old mapping lives until its holders drop it
+        mapping = create(path);
+        if (0 == mapping) {
+            return 0;
+        } else if (mapping->m_size < minSize) {
+            delete mapping;
+            return 0;
+        }
+        mapping->m_shared = true;
+        s_shared.insert(path, mapping);
+        return mapping;
+    }
+
+    void FileMapping::deref()
+    {
+        if (! m_shared) {
+            if (! m_ref.deref()) {
+                delete this;
+            }
+            return;
+        }
+        // shared() must not find a mapping being deleted
+        QMutexLocker locker(&s_mutex);
+        if (! m_ref.deref()) {
+            const QString &path = m_file.fileName();
+            if (s_shared.value(path) == this) {
+                s_shared.remove(path);
+            }
+            delete this;
+        }
+    }
+
+
+    // *********************
+    // ** MappedDevice
+    // *********************
+
+    /// Read-only random access device over a FileMapping.
+    /** Data is copied out by read(), the mapping is never exposed to callers. */
+    class MappedDevice : public QIODevice
+    {
+    public:
+        inline MappedDevice(FileMapping *mapping) :
+            m_mapping(mapping)
+        {
+            m_mapping->ref();
+        }
+
+        inline ~MappedDevice()
+        {
+            close();
+            m_mapping->deref();
+        }
+
+        inline qint64 size() const
+        {
+            return m_mapping->size();
+        }
+
+        /// Returns the mapping, holders need ref() it.
+        inline FileMapping* mapping() const
+        {
+            return m_mapping;
+        }
+
+    protected:
+        qint64 readData(char *data, qint64 maxSize)
+        {
+            qint64 n = qMin(maxSize, m_mapping->size() - pos());
+            if (n <= 0) {
+                return 0;
+            }
+            memcpy(data, m_mapping->data() + pos(), n);
+            return n;
+        }
+
+        qint64 writeData(const char *, qint64)
+        {
+            return -1;
+        }
+
+    private:
+        FileMapping *m_mapping;
+    };
+
+
     // *********************
     // ** NormalFile
     // *********************
@@ -36,7 +221,15 @@ namespace file_object_impl {
     {
     public:
         static NormalFile* createObject(const QString &path, const QString &mime = QString(),
-                                        QObject *parent = 0);
+                                        QObject *parent = 0, bool mapped = false);
+
+        inline ~NormalFile()
+        {
+            if (m_mapping != 0) {
+                m_mapping->deref();
+            }
+        }
+
         inline QString name() const
         {
             return m_path;
@@ -44,35 +237,158 @@ namespace file_object_impl {
         QIODevice* openDevice();
 
         void reset() {}
+
+        qint64 available();
+
+        QByteArray readAll();
+
+        qint64 readAt(qint64 offset, char *data, qint64 maxSize);
+
+        const char* mappedData();
+
     private:
-        inline NormalFile(const QString &path, const QString &mime, QObject *parent) :
-            FileObject(mime, parent), m_path(path)
+        inline NormalFile(const QString &path, const QString &mime, QObject *parent, bool mapped) :
+            FileObject(mime, parent), m_path(path), m_mapped(mapped), m_mapping(0)
         {}
+
+        /// Returns the shared mapping, maps the file on first call.
+        FileMapping* mapping();
     private:
         QString m_path;
+        bool m_mapped;
+        FileMapping *m_mapping;
+        QMutex m_mutex;
     };
 
     NormalFile* NormalFile::createObject(const QString &path, const QString &mime,
-                                         QObject *parent)
+                                         QObject *parent, bool mapped)
     {
         QFile file(path);
         if (! file.exists()) {
             qWarning() << "file" << path << "not exists";
             return 0;
         }
-        return new NormalFile(path, mime, parent);
+        return new NormalFile(path, mime, parent, mapped);
+    }
+
+    FileMapping* NormalFile::mapping()
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_mapped && 0 == m_mapping) {
+            m_mapping = FileMapping::create(m_path);
+            if (0 == m_mapping) {   // fall back to QFile
+                m_mapped = false;
+            }
+        }
+        return m_mapping;
     }
 
     QIODevice* NormalFile::openDevice()
     {
+        FileMapping *map = mapping();
+        if (map != 0) {
+            MappedDevice *device = new MappedDevice(map);
+            if (! device->open(QIODevice::ReadOnly)) {
+                qDebug() << "open mapped device failed";
+                delete device;
+                return 0;
+            }
+            return device;
+        }
         QFile *file = new QFile(m_path);
         if (! file->open(QFile::ReadOnly)) {
             qDebug() << "open file failed";
+            delete file;
             return 0;
         }
         return file;
     }
 
+    qint64 NormalFile::available()
+    {
+        FileMapping *map = mapping();
+        return map != 0 ? map->size() : QFileInfo(m_path).size();
+    }
+
+    QByteArray NormalFile::readAll()
+    {
+        FileMapping *map = mapping();
+        if (map != 0 && map->size() <= INT_MAX) {
+            // owned copy, raw data is only given by mappedData()
+            return QByteArray(map->data(), int(map->size()));
+        }
+        return FileObject::readAll();
+    }
+
+    const char* NormalFile::mappedData()
+    {
+        FileMapping *map = mapping();
+        return map != 0 ? map->data() : 0;
+    }
+
+    qint64 NormalFile::readAt(qint64 offset, char *data, qint64 maxSize)
+    {
+        FileMapping *map = mapping();
+        if (0 == map) {     // each call opens a new file handle
+            return FileObject::readAt(offset, data, maxSize);
+        }
+        if (offset < 0 || maxSize < 0) {
+            return -1;
+        }
+        if (offset >= map->size()) {
+            return 0;
+        }
+        qint64 n = qMin(maxSize, map->size() - offset);
+        std::memcpy(data, map->data() + offset, n);
+        return n;
+    }
+
+
+    // *********************
+    // ** AreaDevice
+    // *********************
+
+    /// Read-only window of a random-access device.
+    /** Reads go to the parent device by position, its cursor is never moved. */
+    class AreaDevice : public QIODevice
+    {
+    public:
+        inline AreaDevice(QIODevice *device, qint64 offset, qint64 size) :
+            m_reader(device), m_offset(offset), m_size(size)
+        {}
+
+        inline bool isSequential() const
+        {
+            return false;
+        }
+
+        inline qint64 size() const
+        {
+            return m_size;
+        }
+
+    protected:
+        qint64 readData(char *data, qint64 maxSize);
+
+        inline qint64 writeData(const char *, qint64)
+        {
+            return -1;
+        }
+
+    private:
+        DeviceReader m_reader;
+        qint64 m_offset, m_size;
+    };
+
+    qint64 AreaDevice::readData(char *data, qint64 maxSize)
+    {
+        qint64 left = m_size - pos();
+        if (left <= 0) {
+            return 0;
+        }
+        return m_reader.readAt(m_offset + pos(), data, qMin(maxSize, left));
+    }
+
 
     // *********************
     // ** AreaFile
@@ -83,29 +399,53 @@ namespace file_object_impl {
     public:
         static AreaFile* createObject(const QString &name, QIODevice *device, qint64 offset,
                                       qint64 size, const QString &mime = QString(), QObject *parent = 0);
+
+        inline ~AreaFile()
+        {
+            if (m_mapping != 0) {
+                m_mapping->deref();
+            }
+            if (m_handles != 0) {
+                m_handles->deref();
+            }
+        }
+
         inline QString name() const
         {
             return m_name;
         }
         QIODevice *openDevice();
-        inline void reset()
+
+        /// Nothing to reset, position of the parent device is never changed.
+        inline void reset() {}
+
+        inline qint64 available()
         {
-            if (m_oldOffset >= 0) {
-                m_device->seek(m_oldOffset);
-            }
+            return m_size;
         }
 
+        qint64 readAt(qint64 offset, char *data, qint64 maxSize);
+
+        /// Returns the area in data of a QBuffer, or in mapping of a mapped file or a QFile.
+        const char* mappedData();
+
     private:
         inline AreaFile(const QString &name, QIODevice *device, qint64 offset, qint64 size,
                         const QString &mime, QObject *parent) :
-            FileObject(mime, parent), m_name(name), m_device(device), m_oldOffset(-1),
-            m_offset(offset), m_size(size)
-        {}
+            FileObject(mime, parent), m_name(name), m_device(device),
+            m_offset(offset), m_size(size), m_mapping(0), m_mapFailed(false)
+        {
+            // readers of the area reuse file handles while the area lives
+            m_handles = DeviceHandles::acquire(device);
+        }
     private:
         QString m_name;
         QIODevice *m_device;
-        qint64 m_oldOffset, m_offset, m_size;
-        QList<QDataStream*> m_opened;
+        qint64 m_offset, m_size;
+        DeviceHandles *m_handles;
+        FileMapping *m_mapping;
+        bool m_mapFailed;
+        QMutex m_mutex;
     };
 
     AreaFile* AreaFile::createObject(const QString &name, QIODevice *device, qint64 offset,
@@ -125,26 +465,454 @@ namespace file_object_impl {
             qWarning() << "size more than file length, available:" << available << ", wanted:" << size;
             return 0;
         }
+        // written data may be buffered, readers see the file by other handles
+        QFile *file = qobject_cast<QFile*>(device);
+        if (file != 0 && file->isWritable()) {
+            file->flush();
+        }
         return new AreaFile(name, device, offset, size, mime, parent);
     }
 
     QIODevice* AreaFile::openDevice()
     {
         Q_ASSERT(m_device != 0);
-        m_oldOffset = m_device->pos();
-        if (! m_device->seek(m_offset)) {
-            qWarning() << "Cannot seek IO device";
+        AreaDevice *area = new AreaDevice(m_device, m_offset, m_size);
+        if (! area->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            qWarning() << "Cannot open area device";
+            delete area;
             return 0;
         }
-        QBuffer *buffer = new QBuffer();
-        if (! buffer->open(QBuffer::ReadWrite)) {
-            qWarning() << "Cannot open QBuffer with ReadWrite";
-            delete buffer;
+        return area;
+    }
+
+    qint64 AreaFile::readAt(qint64 offset, char *data, qint64 maxSize)
+    {
+        if (offset < 0 || maxSize < 0) {
+            return -1;
+        }
+        if (offset >= m_size) {
             return 0;
         }
-        FileUtils::copy(*m_device, *buffer, m_size);
-        buffer->seek(0);
-        return buffer;
+        maxSize = qMin(maxSize, m_size - offset);
+        MappedDevice *mapped = dynamic_cast<MappedDevice*>(m_device);
+        if (mapped != 0) {  // no seeking of the shared device
+            memcpy(data, mapped->mapping()->data() + m_offset + offset, maxSize);
+            return maxSize;
+        }
+        return FileUtils::readAt(*m_device, m_offset + offset, data, maxSize);
+    }
+
+    const char* AreaFile::mappedData()
+    {
+        Q_ASSERT(m_device != 0);
+        QBuffer *buffer = qobject_cast<QBuffer*>(m_device);
+        if (buffer != 0) {
+            return buffer->data().constData() + m_offset;
+        }
+        QMutexLocker locker(&m_mutex);
+        if (0 == m_mapping && ! m_mapFailed) {
+            QFile *file = qobject_cast<QFile*>(m_device);
+            MappedDevice *mapped = dynamic_cast<MappedDevice*>(m_device);
+            if (mapped != 0) {
+                m_mapping = mapped->mapping();
+                m_mapping->ref();
+            } else if (file != 0) {
+                // areas of one file share the mapping, such as chapters of TXT
+                m_mapping = FileMapping::shared(file->fileName(), m_offset + m_size);
+            }
+            m_mapFailed = (0 == m_mapping);
+        }
+        return m_mapping != 0 ? m_mapping->data() + m_offset : 0;
+    }
+
+
+    // *********************
+    // ** ZipIndex
+    // *********************
+
+    /// Entry of ZIP central directory.
+    struct ZipEntry
+    {
+        unz64_file_pos pos;
+        quint16 method;
+        quint16 flags;
+        quint64 compressedSize;
+        quint64 uncompressedSize;
+    };
+
+    /// Independent unzip handle opened on the archive of a ZipIndex.
+    struct ZipHandle
+    {
+        inline ZipHandle(QIODevice *device) :
+            device(device), zip(device)
+        {}
+
+        inline ~ZipHandle()
+        {
+            zip.close();
+            delete device;
+        }
+
+        QIODevice *device;
+        QuaZip zip;
+    };
+
+    /// Name index of ZIP central directory shared by ZipFile objects of one archive.
+    /**
+     * The index is built in one pass over the central directory when the first
+     * ZipFile of the archive is created, the pass also fills the directory map
+     * of QuaZip, so QuaZip::setCurrentFile() will not scan the archive again.
+     *
+     * The index also keeps a pool of unzip handles opened on the same file or
+     * buffer, so entries can be inflated in parallel.
+     */
+    class ZipIndex
+    {
+    public:
+        /// Returns referenced index of \a zip, builds it if not exists.
+        static ZipIndex* acquire(QuaZip *zip);
+
+        /// Forgets index of \a zip, existing holders keep their reference.
+        static void release(QuaZip *zip);
+
+        inline const ZipEntry* entry(const QString &name) const
+        {
+            QHash<QString, ZipEntry>::const_iterator it = m_entries.constFind(name);
+            return it != m_entries.constEnd() ? &it.value() : 0;
+        }
+
+        inline void ref()
+        {
+            m_ref.ref();
+        }
+
+        void deref();
+
+        /// Takes an idle handle or opens new one, returns \c 0 if the archive cannot be reopened.
+        ZipHandle* checkout();
+
+        /// Returns \a handle taken by checkout() to the pool.
+        void checkin(ZipHandle *handle);
+
+        /// Returns mutex serializing use of the QuaZip of the index.
+        inline QMutex* zipMutex()
+        {
+            return &m_zipMutex;
+        }
+
+        /// Returns QuaZip of the index, or \c 0 if released or reopened.
+        /** Use it under zipMutex(), the caller may delete it after release. */
+        inline QuaZip* archive() const
+        {
+            return m_archive;
+        }
+
+        /// Returns device reading the archive for areas of stored entries.
+        /** The device is owned by the index and opened on first call like pooled
+         * handles, returns \c 0 if the archive cannot be reopened.
+         */
+        QIODevice* areaDevice();
+
+        /// Returns offset of data of stored \a entry in the archive.
+        /**
+         * The local header is read by a pooled handle, so the QuaZip of the index
+         * is not used. Returns \c -1 if the entry is compressed or encrypted, or
+         * the archive cannot be reopened.
+         */
+        qint64 storedDataOffset(const ZipEntry &entry);
+
+    private:
+        ZipIndex(QuaZip *zip);
+
+        ~ZipIndex();
+
+        void build();
+
+        /// Forgets the QuaZip, waits for its user holding zipMutex().
+        void dropArchive();
+    private:
+        QuaZip *m_zip;      // key in s_indexes, guarded by s_mutex
+        QuaZip *m_archive;  // guarded by m_zipMutex
+        void *m_unzFile;    // handle of the opened archive, changes when reopened
+        int m_count;
+        QAtomicInt m_ref;
+        QHash<QString, ZipEntry> m_entries;
+
+        // source of pooled handles, path of archive file or data of archive buffer
+        QString m_path;
+        QByteArray m_data;
+        bool m_buffered;
+        QMutex m_poolMutex;
+        QList<ZipHandle*> m_idle;
+        QIODevice *m_areaDevice;    // guarded by m_poolMutex
+        QMutex m_zipMutex;
+
+        static QMutex s_mutex;
+        static QHash<QuaZip*, ZipIndex*> s_indexes;
+    };
+
+    QMutex ZipIndex::s_mutex;
+    QHash<QuaZip*, ZipIndex*> ZipIndex::s_indexes;
+
+    ZipIndex::ZipIndex(QuaZip *zip) :
+        m_zip(zip), m_archive(zip), m_unzFile(zip->getUnzFile()), m_count(0),
+        m_ref(1), m_buffered(false), m_areaDevice(0)
+    {
+        QIODevice *device = zip->getIoDevice();
+        QBuffer *buffer = qobject_cast<QBuffer*>(device);
+        QFile *file = qobject_cast<QFile*>(device);
+        MappedDevice *mapped = dynamic_cast<MappedDevice*>(device);
+        if (0 == device) {      // opened by name
+            m_path = zip->getZipName();
+        } else if (mapped != 0) {
+            m_path = mapped->mapping()->fileName();
+        } else if (buffer != 0) {
+            m_data = buffer->data();    // shared, not copied
+            m_buffered = true;
+        } else if (file != 0) {
+            m_path = file->fileName();
+        }
+    }
+
+    ZipIndex::~ZipIndex()
+    {
+        qDeleteAll(m_idle);
+        delete m_areaDevice;
+    }
+
+    ZipIndex* ZipIndex::acquire(QuaZip *zip)
+    {
+        QMutexLocker locker(&s_mutex);
+        ZipIndex *index = s_indexes.value(zip);
+        if (index != 0 && index->m_unzFile == zip->getUnzFile() &&
+                index->m_count == zip->getEntriesCount()) {
+            index->m_ref.ref();
+            return index;
+        }
+        if (index != 0) {   // archive reopened, leave old index to its owners
+            index->m_zip = 0;
+            index->dropArchive();
+        }
+        index = new ZipIndex(zip);
+        index->build();
+        s_indexes.insert(zip, index);
+        return index;
+    }
+
+    void ZipIndex::release(QuaZip *zip)
+    {
+        QMutexLocker locker(&s_mutex);
+        ZipIndex *index = s_indexes.take(zip);
+        if (index != 0) {
+            index->m_zip = 0;
+            index->dropArchive();
+        }
+    }
+
+    void ZipIndex::dropArchive()
+    {
+        QMutexLocker locker(&m_zipMutex);
+        m_archive = 0;
+    }
+
+    void ZipIndex::deref()
+    {
+        QMutexLocker locker(&s_mutex);
+        if (! m_ref.deref()) {
+            if (m_zip != 0) {
+                s_indexes.remove(m_zip);
+            }
+            delete this;
+        }
+    }
+
+    void ZipIndex::build()
+    {
+        // restore current file of the caller after the pass
+        unz64_file_pos current;
+        QString currentName;
+        bool hasCurrent = m_zip->hasCurrentFile() &&
+                unzGetFilePos64(m_zip->getUnzFile(), &current) == UNZ_OK;
+        if (hasCurrent) {
+            currentName = m_zip->getCurrentFileName();
+        }
+        m_count = m_zip->getEntriesCount();
+        m_entries.reserve(m_count);
+        QuaZipFileInfo64 info;
+        ZipEntry entry;
+        for (bool more = m_zip->goToFirstFile(); more; more = m_zip->goToNextFile()) {
+            if (! m_zip->getCurrentFileInfo(&info) ||
+                    unzGetFilePos64(m_zip->getUnzFile(), &entry.pos) != UNZ_OK) {
+                qWarning() << "Cannot read ZIP central directory:" << m_zip->getZipError();
+                break;
+            }
+            entry.method = info.method;
+            entry.flags = info.flags;
+            entry.compressedSize = info.compressedSize;
+            entry.uncompressedSize = info.uncompressedSize;
+            // first entry wins like QuaZip::setCurrentFile()
+            if (! m_entries.contains(info.name)) {
+                m_entries.insert(info.name, entry);
+            }
+        }
+        m_zip->setCurrentFile(currentName);     // clears current file if empty
+        if (hasCurrent && unzGoToFilePos64(m_zip->getUnzFile(), &current) != UNZ_OK) {
+            qWarning() << "Cannot restore current file of ZIP:" << currentName;
+        }
+    }
+
+
+    ZipHandle* ZipIndex::checkout()
+    {
+        {
+            QMutexLocker locker(&m_poolMutex);
+            if (! m_idle.isEmpty()) {
+                return m_idle.takeLast();
+            }
+        }
+        QIODevice *device;
+        if (m_buffered) {
+            QBuffer *buffer = new QBuffer;
+            buffer->setData(m_data);
+            device = buffer;
+        } else if (! m_path.isEmpty()) {
+            device = new QFile(m_path);
+        } else {
+            return 0;
+        }
+        ZipHandle *handle = new ZipHandle(device);
+        if (! handle->zip.open(QuaZip::mdUnzip)) {
+            qWarning() << "Cannot open ZIP handle:" << handle->zip.getZipError();
+            delete handle;
+            return 0;
+        }
+        return handle;
+    }
+
+    QIODevice* ZipIndex::areaDevice()
+    {
+        QMutexLocker locker(&m_poolMutex);
+        if (m_areaDevice != 0) {
+            return m_areaDevice;
+        }
+        QIODevice *device;
+        if (m_buffered) {
+            QBuffer *buffer = new QBuffer;
+            buffer->setData(m_data);
+            device = buffer;
+        } else if (! m_path.isEmpty()) {
+            device = new QFile(m_path);
+        } else {
+            return 0;
+        }
+        if (! device->open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot reopen ZIP archive:" << m_path;
+            delete device;
+            return 0;
+        }
+        m_areaDevice = device;
+        return device;
+    }
+
+    void ZipIndex::checkin(ZipHandle *handle)
+    {
+        QMutexLocker locker(&m_poolMutex);
+        // keep one idle handle per core at most
+        if (m_idle.size() < qMax(QThread::idealThreadCount(), 1)) {
+            m_idle.append(handle);
+        } else {
+            delete handle;
+        }
+    }
+
+
+    // *********************
+    // ** UnzipDevice
+    // *********************
+
+    /// Reads current file of a pooled handle, returns the handle when destroyed.
+    class UnzipDevice : public QIODevice
+    {
+    public:
+        inline UnzipDevice(ZipIndex *index, ZipHandle *handle, qint64 size) :
+            m_index(index), m_handle(handle), m_size(size), m_read(0)
+        {
+            m_index->ref();
+        }
+
+        ~UnzipDevice();
+
+        inline bool isSequential() const
+        {
+            return true;
+        }
+
+        inline qint64 size() const
+        {
+            return m_size;
+        }
+
+        inline qint64 bytesAvailable() const
+        {
+            return m_size - m_read + QIODevice::bytesAvailable();
+        }
+
+    protected:
+        qint64 readData(char *data, qint64 maxSize);
+
+        inline qint64 writeData(const char *, qint64)
+        {
+            return -1;
+        }
+
+    private:
+        ZipIndex *m_index;
+        ZipHandle *m_handle;
+        qint64 m_size, m_read;
+    };
+
+    UnzipDevice::~UnzipDevice()
+    {
+        close();
+        if (unzCloseCurrentFile(m_handle->zip.getUnzFile()) != UNZ_OK) {
+            qWarning() << "ZIP entry closed with error, CRC mismatch?";
+        }
+        m_index->checkin(m_handle);
+        m_index->deref();
+    }
+
+    qint64 UnzipDevice::readData(char *data, qint64 maxSize)
+    {
+        unsigned len = unsigned(qMin(maxSize, qint64(0x7fffffff)));
+        int n = unzReadCurrentFile(m_handle->zip.getUnzFile(), data, len);
+        if (n < 0) {
+            qWarning() << "Cannot read ZIP entry:" << n;
+            return -1;
+        }
+        m_read += n;
+        return n;
+    }
+
+
+    qint64 ZipIndex::storedDataOffset(const ZipEntry &entry)
+    {
+        if (entry.method != 0 || (entry.flags & 1) != 0) {
+            return -1;
+        }
+        ZipHandle *handle = checkout();
+        if (0 == handle) {
+            return -1;
+        }
+        unzFile uf = handle->zip.getUnzFile();
+        unz64_file_pos pos = entry.pos;
+        qint64 offset = -1;
+        if (unzGoToFilePos64(uf, &pos) == UNZ_OK && unzOpenCurrentFile(uf) == UNZ_OK) {
+            // counts bytes before the archive, such as a SFX stub
+            offset = qint64(unzGetCurrentFileZStreamPos64(uf));
+            unzCloseCurrentFile(uf);
+        }
+        checkin(handle);
+        return offset;
     }
 
 
@@ -155,62 +923,158 @@ namespace file_object_impl {
     class ZipFile : public FileObject
     {
     public:
-        static ZipFile* createObject(QuaZip *zip, const QString &name, const QString &mime,
-                                     QObject *parent = 0);
+        /// Returns ZipFile of entry \a name.
+        /** Stored entries are read as area of the archive reopened by the index,
+         * the offset of the area is resolved on first read.
+         */
+        static FileObject* createObject(QuaZip *zip, const QString &name, const QString &mime,
+                                        QObject *parent = 0);
+
+        inline ~ZipFile()
+        {
+            delete m_area;      // reads device of the index
+            m_index->deref();
+        }
+
         inline QString name() const
         {
             return m_name;
         }
         QIODevice *openDevice();
-        inline void reset()
+        inline void reset() {}
+
+        /// Returns uncompressed size of the entry.
+        inline qint64 available()
         {
-            // reset to old entry
-            if (! m_last.isEmpty()) {
-                m_zip->setCurrentFile(m_last);
-            }
+            return m_entry.uncompressedSize;
         }
 
+        qint64 readAt(qint64 offset, char *data, qint64 maxSize);
+
+        const char* mappedData();
+
     private:
-        ZipFile(QuaZip *zip, const QString &name, const QString &mime, QObject *parent) :
-            FileObject(mime, parent), m_zip(zip), m_name(name)
+        ZipFile(ZipIndex *index, const QString &name, const ZipEntry &entry,
+                const QString &mime, QObject *parent) :
+            FileObject(mime, parent), m_index(index), m_name(name), m_entry(entry),
+            m_area(0), m_resolved(false)
         {}
+
+        /// Returns area of stored entry in the archive device, or \c 0 if not available.
+        FileObject* storedArea();
+
+        /// Opens the entry on a pooled handle, returns \c 0 if no handle available.
+        QIODevice* openPooled();
     private:
-        QuaZip *m_zip;
-        QString m_last, m_name;
+        ZipIndex *m_index;
+        QString m_name;
+        ZipEntry m_entry;
+        FileObject *m_area;     // child of self
+        bool m_resolved;
+        QMutex m_mutex;
     };
 
-    ZipFile* ZipFile::createObject(QuaZip *zip, const QString &name, const QString &mime, QObject *parent)
+    FileObject* ZipFile::createObject(QuaZip *zip, const QString &name, const QString &mime,
+                                      QObject *parent)
     {
         Q_ASSERT(zip != 0);
-        const QString &old = zip->getCurrentFileName();
-        if (! zip->setCurrentFile(name)) {
+        ZipIndex *index = ZipIndex::acquire(zip);
+        const ZipEntry *entry = index->entry(name);
+        if (0 == entry) {
             qWarning() << "Not found file in ZIP:" << name;
+            index->deref();
+            return 0;
+        }
+        return new ZipFile(index, name, *entry, mime, parent);
+    }
+
+    FileObject* ZipFile::storedArea()
+    {
+        QMutexLocker locker(&m_mutex);
+        if (! m_resolved) {
+            m_resolved = true;
+            qint64 offset = m_index->storedDataOffset(m_entry);
+            QIODevice *device = offset >= 0 ? m_index->areaDevice() : 0;
+            if (device != 0) {
+                m_area = AreaFile::createObject(m_name, device, offset,
+                                                m_entry.uncompressedSize, mime(), this);
+            }
+        }
+        return m_area;
+    }
+
+    qint64 ZipFile::readAt(qint64 offset, char *data, qint64 maxSize)
+    {
+        FileObject *area = storedArea();
+        if (area != 0) {
+            return area->readAt(offset, data, maxSize);
+        }
+        return FileObject::readAt(offset, data, maxSize);
+    }
+
+    const char* ZipFile::mappedData()
+    {
+        FileObject *area = storedArea();
+        return area != 0 ? area->mappedData() : 0;
+    }
+
+    QIODevice* ZipFile::openPooled()
+    {
+        ZipHandle *handle = m_index->checkout();
+        if (0 == handle) {
+            return 0;
+        }
+        unzFile uf = handle->zip.getUnzFile();
+        unz64_file_pos pos = m_entry.pos;   // same archive, same directory position
+        if (unzGoToFilePos64(uf, &pos) != UNZ_OK || unzOpenCurrentFile(uf) != UNZ_OK) {
+            m_index->checkin(handle);
             return 0;
         }
-        zip->setCurrentFile(old);
-        return new ZipFile(zip, name, mime, parent);
+        UnzipDevice *device = new UnzipDevice(m_index, handle, m_entry.uncompressedSize);
+        device->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        return device;
     }
 
     QIODevice* ZipFile::openDevice()
     {
-        m_last = m_zip->getCurrentFileName();
-        if (!m_zip->setCurrentFile(m_name)) {
+        FileObject *area = storedArea();
+        if (area != 0) {
+            return area->openDevice();
+        }
+        QIODevice *device = openPooled();
+        if (device != 0) {
+            return device;
+        }
+        // the QuaZip may be used by other I/O tasks, inflate whole entry under lock
+        QMutexLocker locker(m_index->zipMutex());
+        QuaZip *zip = m_index->archive();
+        if (0 == zip) {
+            qWarning() << "ZIP archive was released, cannot open:" << m_name;
             return 0;
         }
-        QuaZipFile *file = new QuaZipFile(m_zip);
-        if (!file->open(QuaZipFile::ReadOnly)) {
-            delete file;
+        // the name is mapped by ZipIndex, no directory scanning
+        if (!zip->setCurrentFile(m_name)) {
             return 0;
         }
-        return file;
+        QuaZipFile file(zip);
+        if (!file.open(QuaZipFile::ReadOnly)) {
+            return 0;
+        }
+        QBuffer *buffer = new QBuffer;
+        buffer->setData(file.readAll());
+        file.close();
+        buffer->open(QBuffer::ReadOnly);
+        return buffer;
     }
 
 }   // end file_object_impl
 
-FileObject* FileFactory::getFile(const QString &name, const QString &mime, QObject *parent)
+FileObject* FileFactory::getFile(const QString &name, const QString &mime, QObject *parent,
+                                 bool mapped)
 {
     return file_object_impl::NormalFile::createObject(name,
-                                                      mime.isEmpty() ? FileUtils::mimeType(name) : mime, parent);
+                                                      mime.isEmpty() ? FileUtils::mimeType(name) : mime, parent,
+                                                      mapped);
 }
 
 FileObject* FileFactory::getFile(const QString &name, QIODevice *device, qint64 offset, qint64 size,
@@ -226,4 +1090,9 @@ FileObject* FileFactory::getFile(QuaZip *zip, const QString &name, const QString
                                                    mime.isEmpty() ? FileUtils::mimeType(name) : mime, parent);
 }
 
+void FileFactory::releaseZip(QuaZip *zip)
+{
+    file_object_impl::ZipIndex::release(zip);
+}
+
 QEM_END_NAMESPACE
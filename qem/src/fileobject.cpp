@@ -18,13 +18,174 @@
 
 #include <fileobject.h>
 #include <fileutils.h>
+#include <contentcache.h>
 #include <QtDebug>
 #include <QVariant>
 #include <QIODevice>
 #include <QByteArray>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QFutureInterface>
+#include <climits>
 
 QEM_BEGIN_NAMESPACE
 
+Q_GLOBAL_STATIC(QThreadPool, fileIoPool)
+
+// guards cached fingerprints of all file objects
+Q_GLOBAL_STATIC(QMutex, fingerprintMutex)
+
+static const qint64 CHUNK_SIZE = 0x10000;
+
+/// Reads next chunk of \a in to \a ba after \a total bytes and adds to \a total.
+/** Returns bytes read, \c 0 at end, or \c -1 if occurs errors or the data is
+ * larger than \c INT_MAX bytes, the most a QByteArray holds.
+ */
+static qint64 readChunk(QIODevice &in, QByteArray &ba, qint64 &total)
+{
+    qint64 chunk = qMin(CHUNK_SIZE, INT_MAX - total);
+    if (0 == chunk) {
+        char c;
+        return in.read(&c, 1) != 0 ? -1 : 0;
+    }
+    ba.resize(int(total + chunk));
+    qint64 n = in.read(ba.data() + total, chunk);
+    if (n > 0) {
+        total += n;
+    }
+    return n;
+}
+
+/// Task of FileObject run in the I/O thread pool.
+template <typename T>
+class FileTask : public QRunnable, public QFutureInterface<T>
+{
+public:
+    inline FileTask(FileObject *file) :
+        m_file(file)
+    {}
+
+    QFuture<T> start()
+    {
+        this->reportStarted();
+        QFuture<T> future = this->future();
+        FileObject::ioThreadPool()->start(this);
+        return future;
+    }
+
+    void run()
+    {
+        if (! this->isCanceled()) {
+            T result;
+            if (execute(result) && ! this->isCanceled()) {
+                this->reportResult(result);
+            }
+        }
+        this->reportFinished();
+    }
+
+protected:
+    /// Returns \c false if canceled or occurs errors.
+    virtual bool execute(T &result) = 0;
+
+    /// Opens device of the file and sets progress range.
+    QIODevice* openDevice()
+    {
+        qint64 size = m_file->available();
+        if (size > 0) {
+            this->setProgressRange(0, int(qMin(size, qint64(INT_MAX))));
+        }
+        return m_file->openDevice();
+    }
+
+    inline void closeDevice(QIODevice *device)
+    {
+        delete device;
+        m_file->reset();
+    }
+
+    FileObject *m_file;
+};
+
+class ReadAllTask : public FileTask<QByteArray>
+{
+public:
+    inline ReadAllTask(FileObject *file) :
+        FileTask<QByteArray>(file)
+    {}
+
+protected:
+    bool execute(QByteArray &result)
+    {
+        qint64 size = m_file->available();
+        QIODevice *in = openDevice();
+        if (0 == in) {
+            return false;
+        }
+        if (size > 0 && size <= INT_MAX) {
+            result.reserve(int(size));
+        }
+        qint64 n, total = 0;
+        do {
+            n = readChunk(*in, result, total);
+            if (n > 0) {
+                setProgressValue(int(total));
+            } else if (n < 0) {
+                qWarning() << "Cannot read whole file:" << m_file->name();
+            }
+        } while (n > 0 && ! isCanceled());
+        result.resize(int(total));
+        closeDevice(in);
+        return n >= 0;
+    }
+};
+
+class CopyTask : public FileTask<qint64>
+{
+public:
+    inline CopyTask(FileObject *file, QIODevice *out, qint64 size) :
+        FileTask<qint64>(file), m_out(out), m_size(size)
+    {}
+
+protected:
+    bool execute(qint64 &result)
+    {
+        QIODevice *in = openDevice();
+        if (0 == in) {
+            return false;
+        }
+        QByteArray buf(int(CHUNK_SIZE), 0);
+        qint64 n;
+        result = 0;
+        while ((m_size < 0 || result < m_size) && ! isCanceled()) {
+            qint64 wanted = m_size < 0 ? CHUNK_SIZE : qMin(CHUNK_SIZE, m_size - result);
+            n = in->read(buf.data(), wanted);
+            if (n < 0) {
+                qWarning() << "Cannot read from IO device";
+                result = -1;
+                break;
+            } else if (0 == n) {
+                break;
+            }
+            if (m_out->write(buf.constData(), n) != n) {
+                qWarning() << "Cannot write to IO device";
+                result = -1;
+                break;
+            }
+            result += n;
+            setProgressValue(int(qMin(result, qint64(INT_MAX))));
+        }
+        closeDevice(in);
+        return true;
+    }
+
+private:
+    QIODevice *m_out;
+    qint64 m_size;
+};
+
+
 FileObject* FileObject::fromQVariant(const QVariant &v, bool *ok)
 {
     if (v.canConvert<FileObjectPointer>()) {
@@ -40,11 +201,48 @@ FileObject* FileObject::fromQVariant(const QVariant &v, bool *ok)
     }
 }
 
+FileObject::~FileObject()
+{
+    if (m_cache != 0) {
+        m_cache->remove(this);
+    }
+}
+
+void FileObject::setCache(ContentCache *cache)
+{
+    if (m_cache == cache) {
+        return;
+    }
+    if (m_cache != 0) {
+        m_cache->remove(this);
+    }
+    m_cache = cache;
+}
+
 QByteArray FileObject::readAll()
 {
+    qint64 size = available();
     QIODevice* in = openDevice();
     Q_ASSERT(in != 0);
-    const QByteArray &ba = in->readAll();
+    QByteArray ba;
+    if (size > INT_MAX) {   // QByteArray holds at most INT_MAX bytes
+        qWarning() << "File is too large to read in memory:" << name();
+    } else if (size < 0) {
+        qint64 n, total = 0;
+        while ((n = readChunk(*in, ba, total)) > 0) {}
+        if (n < 0) {
+            qWarning() << "Cannot read whole file:" << name();
+            total = 0;
+        }
+        ba.resize(int(total));
+    } else {    // allocate once for known size
+        ba.resize(int(size));
+        qint64 n, total = 0;
+        while (total < size && (n = in->read(ba.data() + total, size - total)) > 0) {
+            total += n;
+        }
+        ba.resize(int(total));
+    }
     delete in;
     reset();
     return ba;
@@ -60,4 +258,111 @@ qint64 FileObject::copyTo(QIODevice &out, qint64 size)
     return total;
 }
 
+/// Reads and drops \a size bytes of sequential device \a in.
+/** Returns number of bytes skipped or \c -1 if occurs errors. */
+static qint64 skipBytes(QIODevice &in, qint64 size)
+{
+    QByteArray buf(int(qMin(size, CHUNK_SIZE)), 0);
+    qint64 n, total = 0;
+    while (total < size && (n = in.read(buf.data(), qMin(size - total, CHUNK_SIZE))) != 0) {
+        if (n < 0) {
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
+
+qint64 FileObject::readAt(qint64 offset, char *data, qint64 maxSize)
+{
+    if (offset < 0 || maxSize < 0) {
+        return -1;
+    }
+    QIODevice* in = openDevice();
+    if (0 == in) {
+        return -1;
+    }
+    qint64 n = -1;
+    if (! in->isSequential()) {
+        if (in->seek(offset)) {
+            n = in->read(data, maxSize);
+        }
+    } else {
+        // seek() of sequential device fails or not moves, reads forward instead
+        qint64 skipped = skipBytes(*in, offset);
+        if (skipped == offset) {
+            qint64 r;
+            n = 0;
+            while (n < maxSize && (r = in->read(data + n, maxSize - n)) != 0) {
+                if (r < 0) {
+                    n = -1;
+                    break;
+                }
+                n += r;
+            }
+        } else if (skipped >= 0) {  // offset is beyond end
+            n = 0;
+        }
+    }
+    delete in;
+    reset();
+    return n;
+}
+
+const char* FileObject::mappedData()
+{
+    return 0;
+}
+
+QFuture<QByteArray> FileObject::readAllAsync()
+{
+    return (new ReadAllTask(this))->start();
+}
+
+QFuture<qint64> FileObject::copyToAsync(QIODevice *out, qint64 size)
+{
+    Q_ASSERT(out != 0);
+    return (new CopyTask(this, out, size))->start();
+}
+
+quint64 FileObject::fingerprint()
+{
+    {
+        QMutexLocker locker(fingerprintMutex());
+        if (m_hasFingerprint) {
+            return m_fingerprint;
+        }
+    }
+    // hashes without lock, the result is same in any thread
+    QIODevice *in = openDevice();
+    if (0 == in) {
+        return 0;
+    }
+    quint64 hash = FileUtils::fingerprint(*in);
+    delete in;
+    reset();
+    QMutexLocker locker(fingerprintMutex());
+    m_fingerprint = hash;
+    m_hasFingerprint = true;
+    return hash;
+}
+
+QThreadPool* FileObject::ioThreadPool()
+{
+    return fileIoPool();
+}
+
+QByteArray FileObject::readAt(qint64 offset, qint64 size)
+{
+    if (size <= 0) {
+        return QByteArray();
+    }
+    // QByteArray holds at most INT_MAX bytes
+    size = qMin(size, qint64(INT_MAX));
+    QByteArray ba(int(size), 0);
+    qint64 n = readAt(offset, ba.data(), size);
+    ba.resize(n > 0 ? n : 0);
+    return ba;
+}
+
 QEM_END_NAMESPACE
@@ -18,18 +18,51 @@
 
 #include <fileutils.h>
 #include <fileobject.h>
+#include "devicereader.h"
 #include <QMap>
+#include <QHash>
 #include <QString>
 #include <QtDebug>
+#include <QBuffer>
 #include <QIODevice>
 #include <QDataStream>
 #include <QTextStream>
 #include <QTextCodec>
+#include <QReadWriteLock>
 #include <quazipfile.h>
 #include <quazipnewinfo.h>
+#include <climits>
+#include <cstring>
 
 QEM_BEGIN_NAMESPACE
 
+struct CodecRegistry
+{
+    QReadWriteLock lock;
+    QHash<QByteArray, QTextCodec*> codecs;  // 0 for not found names
+};
+
+Q_GLOBAL_STATIC(CodecRegistry, codecRegistry)
+
+QTextCodec* FileUtils::codecForName(const QByteArray &name)
+{
+    if (name.isEmpty()) {
+        return 0;
+    }
+    CodecRegistry *registry = codecRegistry();
+    {
+        QReadLocker locker(&registry->lock);
+        QHash<QByteArray, QTextCodec*>::const_iterator i = registry->codecs.constFind(name);
+        if (i != registry->codecs.constEnd()) {
+            return i.value();
+        }
+    }
+    QWriteLocker locker(&registry->lock);
+    QTextCodec *codec = QTextCodec::codecForName(name);
+    registry->codecs.insert(name, codec);
+    return codec;
+}
+
 QString FileUtils::extensionName(const QString &name)
 {
     int index = name.lastIndexOf(".");
@@ -80,6 +113,14 @@ static const qint64 BUFFER_SIZE = 4096;
 qint64 FileUtils::copy(QIODevice &in, QIODevice &out, qint64 size)
 {
     Q_ASSERT(in.isReadable() && out.isWritable());
+    QBuffer *buffer = qobject_cast<QBuffer*>(&out);
+    if (buffer != 0) {      // grow output once
+        qint64 n = size >= 0 ? size : in.bytesAvailable();
+        // QByteArray holds at most INT_MAX bytes
+        if (n > 0 && n <= INT_MAX - buffer->pos()) {
+            buffer->buffer().reserve(int(buffer->pos() + n));
+        }
+    }
     char buf[BUFFER_SIZE];
     qint64 n, total = 0;
     while ((n=in.read(buf, BUFFER_SIZE)) > 0) {
@@ -198,6 +239,95 @@ qint64 FileUtils::copy(QTextStream &in, QTextStream &out, qint64 size)
     return total;
 }
 
+static const quint64 FNV_OFFSET_BASIS = Q_UINT64_C(14695981039346656037);
+static const quint64 FNV_PRIME = Q_UINT64_C(1099511628211);
+
+static inline quint64 fnv1a(quint64 hash, const char *data, qint64 size)
+{
+    const uchar *p = reinterpret_cast<const uchar*>(data), *end = p + size;
+    while (p != end) {
+        hash ^= *p++;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+quint64 FileUtils::fingerprint(QIODevice &in, qint64 size)
+{
+    Q_ASSERT(in.isReadable());
+    char buf[BUFFER_SIZE];
+    quint64 hash = FNV_OFFSET_BASIS;
+    qint64 n, total = 0;
+    while ((size < 0 || total < size) &&
+           (n = in.read(buf, size < 0 ? BUFFER_SIZE : qMin(BUFFER_SIZE, size - total))) > 0) {
+        hash = fnv1a(hash, buf, n);
+        total += n;
+    }
+    return hash;
+}
+
+quint64 FileUtils::fingerprint(const QByteArray &data)
+{
+    return fnv1a(FNV_OFFSET_BASIS, data.constData(), data.size());
+}
+
+quint64 FileUtils::fingerprint(const QString &text)
+{
+    return fingerprint(FNV_OFFSET_BASIS, text);
+}
+
+quint64 FileUtils::fingerprint(quint64 hash, const QString &text)
+{
+    const ushort *p = text.utf16(), *end = p + text.size();
+    while (p != end) {
+        hash ^= (*p & 0xFF);
+        hash *= FNV_PRIME;
+        hash ^= (*p++ >> 8);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+qint64 FileUtils::readAt(QIODevice &device, qint64 offset, char *data, qint64 maxSize)
+{
+    DeviceReader reader(&device);
+    return reader.readAt(offset, data, maxSize);
+}
+
+/// Reads at most \a maxSize bytes to \a data, short reads are continued.
+static qint64 readChunk(QIODevice &in, char *data, qint64 maxSize)
+{
+    qint64 n, total = 0;
+    while (total < maxSize && (n = in.read(data + total, maxSize - total)) != 0) {
+        if (n < 0) {
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
+
+bool FileUtils::sameContent(FileObject &a, FileObject &b)
+{
+    const qint64 chunkSize = 64 * 1024;
+    QIODevice *inA = a.openDevice(), *inB = b.openDevice();
+    bool same = inA != 0 && inB != 0;
+    if (same) {
+        QByteArray chunkA(int(chunkSize), 0), chunkB(int(chunkSize), 0);
+        qint64 n;
+        do {
+            n = readChunk(*inA, chunkA.data(), chunkSize);
+            same = n >= 0 && readChunk(*inB, chunkB.data(), chunkSize) == n &&
+                    std::memcmp(chunkA.constData(), chunkB.constData(), size_t(n)) == 0;
+        } while (same && n == chunkSize);
+    }
+    delete inA;
+    delete inB;
+    a.reset();
+    b.reset();
+    return same;
+}
+
 QByteArray FileUtils::readZipData(QuaZip &zip, const QString &entryName, const char *password)
 {
     if (!zip.setCurrentFile(entryName)) {
@@ -254,7 +384,7 @@ QString FileUtils::readZipText(QuaZip &zip, const QString &entryName, const QByt
                                const char *password)
 {
     const QByteArray &data = readZipData(zip, entryName, password);
-    QTextCodec *tc = QTextCodec::codecForName(codec);
+    QTextCodec *tc = codecForName(codec);
     if (0 == tc) {
         qWarning() << "Not found codec:" << codec;
         return QString();
@@ -265,7 +395,7 @@ QString FileUtils::readZipText(QuaZip &zip, const QString &entryName, const QByt
 bool FileUtils::writeZipText(QuaZip &zip, const QString &entryName, const QString &text,
                              const QByteArray &codec, const char *password)
 {
-    QTextCodec *tc = QTextCodec::codecForName(codec);
+    QTextCodec *tc = codecForName(codec);
     if (0 == tc) {
         qWarning() << "Not found codec:" << codec;
         return false;
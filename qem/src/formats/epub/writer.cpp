@@ -19,6 +19,7 @@
 #include "writer.h"
 #include <utils.h>
 #include <fileutils.h>
+#include <linereader.h>
 #include <formats/epub.h>
 #include <QUuid>
 #include <QtDebug>
@@ -47,6 +48,45 @@ inline bool EpubWriter::writeToEpub(QIODevice &device, QuaZip &zip, const QStrin
     return FileUtils::writeToZip(device, zip, opsPath(entryName));
 }
 
+QString EpubWriter::writeUniqueToEpub(FileObject &fb, const QString &entryName)
+{
+    quint64 hash = fb.fingerprint();
+    QMultiHash<quint64, WrittenFile>::const_iterator it = writtenFiles.constFind(hash);
+    for (; it != writtenFiles.constEnd() && it.key() == hash; ++it) {
+        FileObject *other = it.value().file;
+        if (other == &fb || (other->available() == fb.available() && FileUtils::sameContent(*other, fb))) {
+            return it.value().entryName;
+        }
+    }
+    if (! writeToEpub(fb, *zip, entryName)) {
+        return QString();
+    }
+    writtenFiles.insert(hash, WrittenFile(&fb, entryName));
+    writtenNames.insert(entryName);
+    return entryName;
+}
+
+QString EpubWriter::writeImage(FileObject &fb, const QString &id)
+{
+    const QFileInfo info(fb.name());
+    QString entryName = QString("%1/%2").arg(config->imageDir, info.fileName());
+    // different images may have same file name
+    for (int n = 1; writtenNames.contains(entryName); ++n) {
+        entryName = QString("%1/%2-%3").arg(config->imageDir, info.completeBaseName(),
+                                           QString::number(n));
+        if (! info.suffix().isEmpty()) {
+            entryName += "." + info.suffix();
+        }
+    }
+    int written = writtenNames.size();
+    const QString &href = writeUniqueToEpub(fb, entryName);
+    if (writtenNames.size() != written) {   // not a duplicate
+        ++imageCount;
+        addManifestItem(id.isEmpty() ? QString("image-%1").arg(imageCount) : id, href, fb.mime());
+    }
+    return href;
+}
+
 QuaZipFile* EpubWriter::initOpsEntry(const QString &entryName, QString *opsPath)
 {
     QuaZipFile *file = new QuaZipFile(zip, book);
@@ -166,7 +206,7 @@ bool EpubWriter::writeNCX(const QString &bookID)
     }
     QXmlStreamWriter xml(&ncxFile);
     if (!config->xmlEncoding.isEmpty()) {
-        xml.setCodec(config->xmlEncoding.constData());
+        xml.setCodec(FileUtils::codecForName(config->xmlEncoding));
     }
     xml.setAutoFormatting(true);
     xml.writeStartDocument("1.0");
@@ -227,9 +267,10 @@ void EpubWriter::writeHtmlEnd(QXmlStreamWriter &xml)
     xml.writeEndElement();  // </html>
 }
 
-void EpubWriter::writeHtmlPara(QXmlStreamWriter &xml, const QStringList &lines)
+void EpubWriter::writeHtmlPara(QXmlStreamWriter &xml, LineReader &reader)
 {
-    foreach (const QString &line, lines) {
+    QString line;
+    while (reader.readLine(line)) {
         xml.writeTextElement("p", line.trimmed());
     }
 }
@@ -242,7 +283,7 @@ bool EpubWriter::writeCoverPage(const QString &title, const QString &href, const
     }
     QXmlStreamWriter xml(htmlFile);
     if (!config->xmlEncoding.isEmpty()) {
-        xml.setCodec(config->xmlEncoding.constData());
+        xml.setCodec(FileUtils::codecForName(config->xmlEncoding));
     }
     xml.setAutoFormatting(true);
     writeHtmlStart(xml, title, css);
@@ -266,7 +307,7 @@ bool EpubWriter::writeIntroPage(const QString &href)
     }
     QXmlStreamWriter xml(htmlFile);
     if (!config->xmlEncoding.isEmpty()) {
-        xml.setCodec(config->xmlEncoding.constData());
+        xml.setCodec(FileUtils::codecForName(config->xmlEncoding));
     }
     xml.setAutoFormatting(true);
     writeHtmlStart(xml, EPUB::IntroPageTitle, css);
@@ -279,7 +320,9 @@ bool EpubWriter::writeIntroPage(const QString &href)
     xml.writeStartElement("div");
     xml.writeAttribute("class", config->introContentStyle);
     xml.writeTextElement("h3", QObject::tr("Intro"));
-    writeHtmlPara(xml, book->intro().lines(true));
+    LineReader *reader = book->intro().lineReader(true);
+    writeHtmlPara(xml, *reader);
+    delete reader;
     xml.writeEndElement();          // </div>
 
     writeHtmlEnd(xml);
@@ -295,7 +338,7 @@ bool EpubWriter::writeInfoPage(const QString &href)
     }
     QXmlStreamWriter xml(htmlFile);
     if (!config->xmlEncoding.isEmpty()) {
-        xml.setCodec(config->xmlEncoding.constData());
+        xml.setCodec(FileUtils::codecForName(config->xmlEncoding));
     }
     xml.setAutoFormatting(true);
     writeHtmlStart(xml, EPUB::InfoPageTitle, css);
@@ -318,12 +361,9 @@ bool EpubWriterV2::make()
     // write cover
     FileObject *fb = book->cover();
     if (fb != 0) {
-        cover = QString("%1/%2").arg(config->imageDir, QFileInfo(fb->name()).fileName());
-        if (!writeToEpub(*fb, *zip, cover)) {
+        cover = writeImage(*fb, EPUB::CoverFileID);
+        if (cover.isEmpty()) {
             qWarning() << "Cannot write cover image:" << fb->name();
-            cover.clear();
-        } else {
-            addManifestItem(EPUB::CoverFileID, cover, fb->mime());
         }
     }
     // main CSS
@@ -22,6 +22,8 @@
 #include <qem_global.h>
 #include <QList>
 #include <QString>
+#include <QMultiHash>
+#include <QSet>
 
 class QuaZip;
 class QuaZipFile;
@@ -32,17 +34,19 @@ QEM_BEGIN_NAMESPACE
 
 class Book;
 class FileObject;
+class LineReader;
 
 namespace epub
 {
 
 class EpubMakeConfig;
 
-class EpubWriter
+class QEM_SHARED_EXPORT EpubWriter
 {
 public:
     inline EpubWriter(const Book &book, QuaZip &zip, const EpubMakeConfig &config, QString *error) :
-        book(const_cast<Book*>(&book)), zip(&zip), config(const_cast<EpubMakeConfig*>(&config)), error(error)
+        book(const_cast<Book*>(&book)), zip(&zip), config(const_cast<EpubMakeConfig*>(&config)), error(error),
+        imageCount(0)
     {}
     virtual ~EpubWriter()
     {}
@@ -56,6 +60,20 @@ protected:
 
     bool writeToEpub(QIODevice &device, QuaZip &zip, const QString &entryName);
 
+    /// Writes FileObject to \a entryName unless same content was written before.
+    /**
+     * Contents are matched by fingerprint, size and bytes. Returns \a entryName or
+     * name of the entry having same content, or empty string if failed to write.
+     */
+    QString writeUniqueToEpub(FileObject &fb, const QString &entryName);
+
+    /// Writes image \a fb to image directory once, adds manifest item \a id when written.
+    /**
+     * If \a id is empty, a new ID is generated. Returns entry name of the image,
+     * or empty string if failed to write.
+     */
+    QString writeImage(FileObject &fb, const QString &id = QString());
+
     /// Write MIME type file to EPUB.
     bool writeMt();
 
@@ -120,7 +138,7 @@ protected:
     // write </body>, </html>
     void writeHtmlEnd(QXmlStreamWriter &xml);
 
-    void writeHtmlPara(QXmlStreamWriter &xml, const QStringList &lines);
+    void writeHtmlPara(QXmlStreamWriter &xml, LineReader &reader);
 
     bool writeCoverPage(const QString &title, const QString &href, const QString &img);
 
@@ -141,9 +159,23 @@ protected:
     QList<SpineItem> spineItems;
     QList<GuideItem> guideItems;
     QString cover, css;
+
+    struct WrittenFile {
+        FileObject *file;
+        QString entryName;
+        inline WrittenFile(FileObject *file, const QString &entryName) :
+            file(file), entryName(entryName)
+        {}
+    };
+    /// Written file objects by fingerprint.
+    QMultiHash<quint64, WrittenFile> writtenFiles;
+    /// Names of written entries.
+    QSet<QString> writtenNames;
+    /// Number of images written by writeImage().
+    int imageCount;
 };
 
-class EpubWriterV2 : public EpubWriter
+class QEM_SHARED_EXPORT EpubWriterV2 : public EpubWriter
 {
 public:
     inline EpubWriterV2(const Book &book, QuaZip &zip, const EpubMakeConfig &config, QString *error) :
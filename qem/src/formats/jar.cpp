@@ -19,6 +19,7 @@
 #include <formats/jar.h>
 #include <utils.h>
 #include <filefactory.h>
+#include <fileutils.h>
 #include <QtDebug>
 #include <QTextCodec>
 #include <QDataStream>
@@ -39,6 +40,7 @@ namespace jar
     static void deleteQuaZip(Part &part, void *arg)
     {
         QuaZip *zip = static_cast<QuaZip*>(arg);
+        FileFactory::releaseZip(zip);
         delete zip;
     }
 
@@ -53,6 +55,7 @@ namespace jar
         }
         Book *book = parseJar(*zip, args, error);
         if (0 == book) {
+            FileFactory::releaseZip(zip);
             delete zip;
         } else {
             book->registerCleaner(deleteQuaZip, zip);
@@ -94,7 +97,7 @@ namespace jar
         }
         quint8 n8;
         in >> n8;
-        QTextCodec *headCodec = QTextCodec::codecForName(HEAD_ENCODING);
+        QTextCodec *headCodec = FileUtils::codecForName(HEAD_ENCODING);
         char *buf = new char[n8];
         if (in.readRawData(buf, n8) != n8) {
             debug("Bad JAR book file: title", error);
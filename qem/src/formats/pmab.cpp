@@ -75,6 +75,7 @@ namespace pmab
     static void deleteQuaZip(Part &part, void *arg)
     {
         QuaZip *zip = static_cast<QuaZip*>(arg);
+        FileFactory::releaseZip(zip);
         delete zip;
     }
 
@@ -105,6 +106,7 @@ namespace pmab
         }
         Book *book = parsePmab(*zip, error);
         if (0 == book) {
+            FileFactory::releaseZip(zip);
             delete zip;
         } else {
             book->registerCleaner(deleteQuaZip, zip);
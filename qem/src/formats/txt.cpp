@@ -21,6 +21,7 @@
 #include <utils.h>
 #include <fileutils.h>
 #include <textobject.h>
+#include <linereader.h>
 #include <filefactory.h>
 #include <QFile>
 #include <QtDebug>
@@ -69,8 +70,9 @@ namespace txt
             regex = ChapterRegex;
         }
         QTextStream in(&device);
-        if (! codec.isEmpty()) {
-            in.setCodec(codec.constData());
+        QTextCodec *textCodec = codec.isEmpty() ? 0 : FileUtils::codecForName(codec);
+        if (textCodec != 0) {
+            in.setCodec(textCodec);
         }
         return parseTxt(in, title, regex, error);
     }
@@ -185,19 +187,24 @@ namespace txt
     bool TXT::makeTxt(const Book &book, QTextStream &out, const QByteArray &encoding,
                       const QString &lineFeed, const QString &paraStart, bool skipEmptyLine, QString *error)
     {
-        out.setCodec(encoding.constData());
+        QTextCodec *codec = encoding.isEmpty() ? 0 : FileUtils::codecForName(encoding);
+        if (codec != 0) {
+            out.setCodec(codec);
+        }
         out << book.title() << lineFeed;
         const QString &author = book.author();
         if (!author.isEmpty()) {
             out << author << lineFeed;
         }
-        const QStringList &lines = book.intro().lines(skipEmptyLine);
-        foreach (const QString &line, lines) {
+        QString line;
+        LineReader *reader = book.intro().lineReader(skipEmptyLine);
+        while (reader->readLine(line)) {
             if (! line.isEmpty()) {
                 out << paraStart << line.trimmed();
             }
             out  << lineFeed;
         }
+        delete reader;
         out.flush();
         for (int ix = 0; ix < book.size(); ++ix) {
             const Part *p = book.at(ix);
@@ -213,16 +220,18 @@ namespace txt
         Q_ASSERT(part != 0);
         out << lineFeed << part->title() << lineFeed;
         if (! part->isSection()) {  // no sub items
-            const QStringList &lines = part->lines();
-            QStringList::const_iterator i = lines.constBegin();
-            for (; i != lines.constEnd(); ++i) {
-                const QString &line = (*i).trimmed();
+            // streams lines, the whole content is never loaded
+            QString line;
+            LineReader *reader = part->lineReader();
+            while (reader->readLine(line)) {
+                line = line.trimmed();
                 if (line.isEmpty() && skipEmptyLine) {
                     continue;
                 }
                 out << paraStart << line;
                 out << lineFeed;
             }
+            delete reader;
             out.flush();
         } else {
             for (int ix = 0; ix < part->size(); ++ix) {
@@ -19,12 +19,18 @@
 #include <formats/umd.h>
 #include <utils.h>
 #include <filefactory.h>
+#include <fileutils.h>
+#include <linereader.h>
+#include "../devicereader.h"
+#include "../textcounter.h"
 #include <QDate>
 #include <QtDebug>
 #include <QTextCodec>
+#include <QTextDecoder>
 #include <QByteArray>
 #include <QStringList>
 #include <QDataStream>
+#include <climits>
 
 QEM_BEGIN_NAMESPACE
 
@@ -243,24 +249,41 @@ FINISHED:
             if (0 == --m_blocks->ref) {
                 delete m_blocks;
             }
+            if (m_handles != 0) {
+                m_handles->deref();
+            }
         }
 
         inline void setText(const QString &text)
         {
             Chapter::setText(text);
             m_fromUmd = false;
+            m_hasStats = false;
+            m_hasFingerprint = false;
         }
 
         inline void setFile(FileObject *file, const QByteArray &codec = QByteArray())
         {
             Chapter::setFile(file, codec);
             m_fromUmd = false;
+            m_hasStats = false;
+            m_hasFingerprint = false;
         }
 
         QString content() const;
 
+        QString preview(int maxChars) const;
+
+        TextStats stats() const;
+
+        quint64 fingerprint() const;
+
+        /// Empty lines of UMD text are always skipped, \a skipEmptyLine is ignored.
         QStringList lines(bool skipEmptyLine = true) const;
 
+        /// Empty lines are always skipped like lines(), \a skipEmptyLine is ignored.
+        LineReader* lineReader(bool skipEmptyLine = true) const;
+
         qint64 writeTo(QTextStream &out, qint64 size = -1) const;
 
         qint64 writeTo(QIODevice &out, const QByteArray &encoding = QByteArray(), qint64 size = -1) const;
@@ -275,18 +298,27 @@ FINISHED:
             return m_length;
         }
     private:
-        QString rawText() const;
+        /// Returns text of first \a bytes bytes, or whole text if \a bytes < 0.
+        QString rawText(qint32 bytes = -1) const;
+
+        friend class UmdLineReader;
     private:
         ref_ptr<BlockList> *m_blocks;
         mutable QIODevice *m_file;
+        DeviceHandles *m_handles;   // reused by readers of m_file
         qint32 m_offset, m_length;
         bool m_fromUmd;
+        mutable TextStats m_stats;
+        mutable bool m_hasStats;
+        mutable quint64 m_fingerprint;
+        mutable bool m_hasFingerprint;
     };
 
     UmdChapter::UmdChapter(const QString &title, ref_ptr<BlockList> *blocks, QIODevice *file,
                            qint32 offset, qint32 length, QObject *parent):
         Chapter(title, "", 0, TextObject(), parent), m_blocks(blocks), m_file(file),
-        m_offset(offset), m_length(length), m_fromUmd(true)
+        m_handles(DeviceHandles::acquire(file)), m_offset(offset), m_length(length), m_fromUmd(true), m_hasStats(false),
+        m_fingerprint(0), m_hasFingerprint(false)
     {}
 
     static void makeUint32(quint32 x, char *b)
@@ -297,26 +329,96 @@ FINISHED:
         b[3] = (char)x;
     }
 
-    QString UmdChapter::rawText() const
+    /// Reads and uncompresses content block, returns empty array if failed.
+    static QByteArray readBlock(DeviceReader &reader, const ContentBlock &block)
+    {
+        char *bytes = new char[block.length+4];    // 4 bytes header and data
+        makeUint32(block.length, bytes);
+        qint64 n = reader.readAt(block.offset, bytes+4, block.length);
+        if (n < 0) {
+            delete []bytes;
+            qWarning() << "Cannot read UMD content block at" << block.offset;
+            return QByteArray();
+        }
+        QByteArray res = qUncompress(reinterpret_cast<const uchar*>(bytes), n+4);
+        delete []bytes;
+        return res;
+    }
+
+    QString UmdChapter::rawText(qint32 bytes) const
     {
+        if (bytes < 0 || bytes > m_length) {
+            bytes = m_length;
+        }
+        const BlockList &blocks = *m_blocks->data;
         qint32 index = m_offset / BUFFER_SIZE;
         qint32 start = m_offset % BUFFER_SIZE;
         qint32 length = -start;
         QByteArray data;
-        do {
-            const ContentBlock &block = m_blocks->data->at(index++);
-            m_file->seek(block.offset);
-            char *bytes = new char[block.length+4];    // 4 bytes header and data
-            makeUint32(block.length, bytes);
-            quint64 n = m_file->read(bytes+4, block.length);
-            QByteArray res = qUncompress(reinterpret_cast<const uchar*>(bytes), n+4);
-            delete []bytes;
+        DeviceReader reader(m_file);    // leaves position of the shared file
+        // only blocks holding the leading bytes are uncompressed
+        while (length < bytes && index < blocks.size()) {
+            const QByteArray &res = readBlock(reader, blocks.at(index++));
+            if (res.isEmpty()) {
+                return QString();
+            }
             length += res.size();
             data.append(res);
-            if (m_length < length) {
-                return umdCodec()->toUnicode(data.mid(start, m_length));
+        }
+        return umdCodec()->toUnicode(data.mid(start, bytes));
+    }
+
+    /// Reads lines of UmdChapter by content blocks.
+    class UmdLineReader : public LineReader
+    {
+    public:
+        inline UmdLineReader(const UmdChapter &chapter) :
+            LineReader(QString(), true), m_chapter(chapter), m_reader(chapter.m_file),
+            m_decoder(umdCodec()->makeDecoder()),
+            m_index(chapter.m_offset / BUFFER_SIZE), m_start(chapter.m_offset % BUFFER_SIZE),
+            m_left(chapter.m_length)
+        {}
+
+        inline ~UmdLineReader()
+        {
+            delete m_decoder;
+        }
+
+    protected:
+        QString readChunk();
+
+        /// Returns next decoded chunk with Symbian line feeds.
+        QString readText();
+
+    private:
+        friend class UmdChapter;
+        const UmdChapter &m_chapter;
+        DeviceReader m_reader;
+        QTextDecoder *m_decoder;
+        qint32 m_index, m_start, m_left;
+    };
+
+    QString UmdLineReader::readChunk()
+    {
+        return readText().replace(SYMBIAN_LINE_FEED, QChar('\n'));
+    }
+
+    QString UmdLineReader::readText()
+    {
+        const BlockList &blocks = *m_chapter.m_blocks->data;
+        QString text;
+        // one block each time, a block may only hold part of a character
+        while (text.isEmpty() && m_left > 0 && m_index < blocks.size()) {
+            const QByteArray &res = readBlock(m_reader, blocks.at(m_index++));
+            if (res.isEmpty()) {
+                break;
             }
-        } while (true);
+            const QByteArray &data = res.mid(m_start, m_left);
+            m_start = 0;
+            m_left -= data.size();
+            text = m_decoder->toUnicode(data);
+        }
+        return text;
     }
 
     QString UmdChapter::content() const
@@ -328,6 +430,56 @@ FINISHED:
         }
     }
 
+    QString UmdChapter::preview(int maxChars) const
+    {
+        if (! m_fromUmd) {
+            return Chapter::preview(maxChars);
+        } else if (maxChars <= 0) {
+            return QString();
+        }
+        // UTF-16LE, line feed is not shorter than Symbian one
+        return rawText(int(qMin<qint64>(maxChars, INT_MAX / 2) * 2)).replace(SYMBIAN_LINE_FEED, LOCAL_LINE_FEED).left(maxChars);
+    }
+
+    TextStats UmdChapter::stats() const
+    {
+        if (! m_fromUmd) {
+            return Chapter::stats();
+        } else if (! m_hasStats) {
+            // counts decoded blocks one by one
+            TextCounter counter;
+            UmdLineReader reader(*this);
+            QString chunk;
+            do {
+                chunk = reader.readChunk();
+                counter.add(chunk);
+            } while (! chunk.isEmpty());
+            m_stats = counter.stats(m_length);
+            m_stats.chars += m_stats.lines - 1;     // content() uses CR LF
+            m_hasStats = true;
+        }
+        return m_stats;
+    }
+
+    quint64 UmdChapter::fingerprint() const
+    {
+        if (! m_fromUmd) {
+            return Chapter::fingerprint();
+        } else if (! m_hasFingerprint) {
+            // hashes same text as content() by blocks
+            UmdLineReader reader(*this);
+            quint64 hash = FileUtils::fingerprint(QString());
+            QString chunk;
+            do {
+                chunk = reader.readText();
+                hash = FileUtils::fingerprint(hash, chunk.replace(SYMBIAN_LINE_FEED, LOCAL_LINE_FEED));
+            } while (! chunk.isEmpty());
+            m_fingerprint = hash;
+            m_hasFingerprint = true;
+        }
+        return m_fingerprint;
+    }
+
     QStringList UmdChapter::lines(bool skipEmptyLine) const
     {
         if (! m_fromUmd) {
@@ -338,17 +490,22 @@ FINISHED:
         }
     }
 
+    LineReader* UmdChapter::lineReader(bool skipEmptyLine) const
+    {
+        if (! m_fromUmd) {
+            return Chapter::lineReader(skipEmptyLine);
+        }
+        return new UmdLineReader(*this);
+    }
+
     qint64 UmdChapter::writeTo(QTextStream &out, qint64 size) const
     {
         if (! m_fromUmd) {
             return Chapter::writeTo(out, size);
         } else {
-            const QString &s = content();
-            if (size < 0) {
-                size = s.length();
-            }
-            out << s.left(size);
-            return size;
+            const QString &s = (size < 0) ? content() : preview(int(qMin(size, qint64(INT_MAX))));
+            out << s;
+            return s.length();
         }
     }
 
@@ -357,17 +514,14 @@ FINISHED:
         if (! m_fromUmd) {
             return Chapter::writeTo(out, encoding, size);
         } else {
-            QTextCodec *ts = QTextCodec::codecForName(encoding);
+            QTextCodec *ts = FileUtils::codecForName(encoding);
             if (0 == ts) {
                 qWarning() << "Not found codec:" << encoding;
                 return -1;
             }
-            const QString &s = content();
-            if (size < 0) {
-                size = s.length();
-            }
-            out.write(ts->fromUnicode(s.left(size)));
-            return size;
+            const QString &s = (size < 0) ? content() : preview(int(qMin(size, qint64(INT_MAX))));
+            out.write(ts->fromUnicode(s));
+            return s.length();
         }
     }
 
@@ -685,7 +839,7 @@ FINISHED:
             if (0 == chapter) {     // not created
                 chapter = new UmdChapter("", umdData.blocks, in.device(), offset, 0, umdData.book);
                 ++umdData.blocks->ref;
-                umdData.book->append(chapter);
+                umdData.book->add(chapter);
             } else {
                 chapter->textOffset() = offset;
             }
@@ -724,7 +878,7 @@ FINISHED:
             if (0 == chapter) {     // not created
                 chapter = new UmdChapter(title, umdData.blocks, in.device(), 0, 0, umdData.book);
                 ++umdData.blocks->ref;
-                umdData.book->append(chapter);
+                umdData.book->add(chapter);
             } else {
                 chapter->setTitle(title);
             }
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <linereader.h>
+#include "linesplitter.h"
+
+QEM_BEGIN_NAMESPACE
+
+LineReader::LineReader(const QString &text, bool skipEmptyLine) :
+    m_buffer(text), m_pos(0), m_atEnd(false), m_done(false), m_skipEmptyLine(skipEmptyLine)
+{}
+
+LineReader::~LineReader()
+{}
+
+QString LineReader::readChunk()
+{
+    return QString();
+}
+
+bool LineReader::fill()
+{
+    if (m_atEnd) {
+        return false;
+    }
+    const QString &chunk = readChunk();
+    if (chunk.isEmpty()) {
+        m_atEnd = true;
+        return false;
+    }
+    m_buffer.remove(0, m_pos);      // drop lines already read
+    m_pos = 0;
+    m_buffer.append(chunk);
+    return true;
+}
+
+bool LineReader::readLine(QString &line)
+{
+    while (! m_done) {
+        int size = m_buffer.size();
+        int end = LineSplitter::indexOfBreak(m_buffer.constData(), m_pos, size);
+        // need more text for the line or for LF after CR
+        if ((end == size || (end + 1 == size && '\r' == m_buffer.at(end))) && fill()) {
+            continue;
+        }
+        // deep copy, the buffer may be a view of mapped file
+        line = QString(m_buffer.constData() + m_pos, end - m_pos);
+        if (end == size) {
+            m_done = true;
+        } else {
+            m_pos = end + 1;
+            if ('\r' == m_buffer.at(end) && m_pos < size && '\n' == m_buffer.at(m_pos)) {
+                ++m_pos;
+            }
+        }
+        if (! line.isEmpty() || ! m_skipEmptyLine) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QEM_END_NAMESPACE
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linesplitter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define QEM_LINESPLITTER_SSE2
+# include <emmintrin.h>
+#endif
+
+QEM_BEGIN_NAMESPACE
+
+static inline bool isBreak(ushort c)
+{
+    return '\n' == c || '\r' == c;
+}
+
+#ifdef QEM_LINESPLITTER_SSE2
+static inline int firstBit(uint mask)
+{
+# if defined(Q_CC_GNU)
+    return __builtin_ctz(mask);
+# else
+    int n = 0;
+    while (! (mask & 1)) {
+        mask >>= 1;
+        ++n;
+    }
+    return n;
+# endif
+}
+#endif
+
+int LineSplitter::indexOfBreak(const QChar *data, int from, int size)
+{
+    const ushort *s = reinterpret_cast<const ushort*>(data);
+    int i = from;
+#ifdef QEM_LINESPLITTER_SSE2
+    // compare 8 code units each time
+    const __m128i cr = _mm_set1_epi16('\r'), lf = _mm_set1_epi16('\n');
+    for (; i + 8 <= size; i += 8) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi16(chunk, cr), _mm_cmpeq_epi16(chunk, lf));
+        uint mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return i + firstBit(mask) / 2;     // two mask bits per code unit
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (isBreak(s[i])) {
+            return i;
+        }
+    }
+    return size;
+}
+
+QVector<QStringRef> LineSplitter::splitRef(const QString &text, bool skipEmptyLine)
+{
+    QVector<QStringRef> lines;
+    const QChar *data = text.constData();
+    int size = text.size(), start = 0;
+    while (true) {
+        int end = indexOfBreak(data, start, size);
+        if (end > start || ! skipEmptyLine) {
+            lines.append(QStringRef(&text, start, end - start));
+        }
+        if (end == size) {
+            break;
+        }
+        start = end + 1;
+        if ('\r' == data[end].unicode() && start < size && '\n' == data[start].unicode()) {
+            ++start;
+        }
+    }
+    return lines;
+}
+
+QStringList LineSplitter::split(const QString &text, bool skipEmptyLine)
+{
+    const QVector<QStringRef> &refs = splitRef(text, skipEmptyLine);
+    QStringList lines;
+    lines.reserve(refs.size());
+    foreach (const QStringRef &ref, refs) {
+        lines.append(ref.toString());
+    }
+    return lines;
+}
+
+QEM_END_NAMESPACE
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QEM_LINESPLITTER_H
+#define QEM_LINESPLITTER_H
+
+#include <qem_global.h>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+
+QEM_BEGIN_NAMESPACE
+
+/// Splits UTF-16 text by CR LF, CR or LF in one pass.
+/**
+ * Gives same result as QString::split() with QRegExp("(\\r\\n|\\r|\\n)"), the
+ * line breaks are searched by SSE2 when the compiler targets it.
+ */
+class LineSplitter
+{
+private:
+    LineSplitter();
+public:
+    /// Returns index of first CR or LF in \a data from \a from to \a size, or \a size if not found.
+    static int indexOfBreak(const QChar *data, int from, int size);
+
+    /// Returns references of lines in \a text.
+    /** The references are valid while \a text is not changed or destroyed. */
+    static QVector<QStringRef> splitRef(const QString &text, bool skipEmptyLine = false);
+
+    /// Returns lines of \a text.
+    static QStringList split(const QString &text, bool skipEmptyLine = false);
+};
+
+QEM_END_NAMESPACE
+
+#endif // QEM_LINESPLITTER_H
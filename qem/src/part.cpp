@@ -17,7 +17,11 @@
  */
 
 #include <part.h>
+#include <fileutils.h>
 #include <QtDebug>
+#include <QDataStream>
+#include <QMultiHash>
+#include <QMutex>
 
 QEM_BEGIN_NAMESPACE
 
@@ -32,63 +36,223 @@ class PartPrivate
     CleanerList cleaners;
     TextObject source;
 
+    // typed field of title attribute
+    QString title;
+    bool hasTitle;
+
+    // title -> index of sub-parts, 0 if not enabled
+    typedef QMultiHash<QString, int> TitleIndex;
+    TitleIndex *titleIndex;
+
+    // parts listing self once for each listing, the first one is the owner,
+    // others are only kept when listed several times, such as by a copy
+    Part *owner;
+    QList<Part*> *moreOwners;
+
+    // changed when sub-parts tree changed
+    int revision;
+    // aggregates of sub-parts tree, updated with changes of the list
+    int depth;
+    int descendants;
+    // cached sum of sub-parts stats, 0 if not computed
+    TextStats *stats;
+
     inline PartPrivate(const QString &text) :
-        id(++objectCount), source(TextObject(text))
+        id(++objectCount), source(TextObject(text)), hasTitle(false), titleIndex(0),
+        owner(0), moreOwners(0), revision(0), depth(0), descendants(0),
+        stats(0)
     {}
     inline PartPrivate(FileObject *file, const QByteArray codec) :
-        id(++objectCount), source(TextObject(file, codec))
+        id(++objectCount), source(TextObject(file, codec)), hasTitle(false), titleIndex(0),
+        owner(0), moreOwners(0), revision(0), depth(0), descendants(0),
+        stats(0)
     {}
     inline PartPrivate(const TextObject &source) :
-        id(++objectCount), source(source)
+        id(++objectCount), source(source), hasTitle(false), titleIndex(0), owner(0),
+        moreOwners(0), revision(0), depth(0), descendants(0), stats(0)
     {}
+    // the list is copied with aggregates
     inline PartPrivate(const PartPrivate &other) :
-        cleaners(other.cleaners), source(other.source)
+        id(++objectCount), cleaners(other.cleaners), source(other.source), hasTitle(false),
+        titleIndex(0), owner(0), moreOwners(0), revision(0), depth(other.depth),
+        descendants(other.descendants), stats(0)
     {}
+    inline ~PartPrivate()
+    {
+        delete titleIndex;
+        delete moreOwners;
+        delete stats;
+    }
+    // title is assigned by Attributes, the list and aggregates by Part
     inline PartPrivate& operator =(const PartPrivate &other)
     {
         cleaners = other.cleaners;
         source = other.source;
         return *this;
     }
+
+    inline int ownerCount() const
+    {
+        return 0 == owner ? 0 : 1 + (0 == moreOwners ? 0 : moreOwners->size());
+    }
+
+    inline Part* ownerAt(int i) const
+    {
+        return 0 == i ? owner : moreOwners->at(i - 1);
+    }
+
+    void addOwner(Part *part);
+
+    void removeOwner(Part *part);
+
+    /// Rebuilds the title index from sub-parts of \a part if enabled.
+    void buildIndex(const Part &part);
+
+    /// Adds \a title of sub-part inserted at \a i, shifting indexes after it.
+    void indexInserted(int i, const QString &title);
+
+    /// Removes \a title of sub-part removed from \a i, shifting indexes after it.
+    void indexRemoved(int i, const QString &title);
 };
 
 int PartPrivate::objectCount = 0;
 
+// guards cached stats of sections
+Q_GLOBAL_STATIC(QMutex, statsMutex)
+
+void PartPrivate::addOwner(Part *part)
+{
+    if (0 == owner) {
+        owner = part;
+    } else {
+        if (0 == moreOwners) {
+            moreOwners = new QList<Part*>();
+        }
+        moreOwners->append(part);
+    }
+}
+
+void PartPrivate::removeOwner(Part *part)
+{
+    // keeps the owner if also listed by other ways
+    if (0 == moreOwners || ! moreOwners->removeOne(part)) {
+        if (owner != part) {
+            return;
+        }
+        owner = (moreOwners != 0 && ! moreOwners->isEmpty()) ? moreOwners->takeFirst() : 0;
+    }
+    if (moreOwners != 0 && moreOwners->isEmpty()) {
+        delete moreOwners;
+        moreOwners = 0;
+    }
+}
+
+void PartPrivate::buildIndex(const Part &part)
+{
+    if (0 == titleIndex) {
+        return;
+    }
+    titleIndex->clear();
+    titleIndex->reserve(part.size());
+    for (int ix = 0; ix < part.size(); ++ix) {
+        titleIndex->insert(part.at(ix)->title(), ix);
+    }
+}
+
+void PartPrivate::indexInserted(int i, const QString &title)
+{
+    if (0 == titleIndex) {
+        return;
+    }
+    for (TitleIndex::iterator it = titleIndex->begin(); it != titleIndex->end(); ++it) {
+        if (it.value() >= i) {
+            ++it.value();
+        }
+    }
+    titleIndex->insert(title, i);
+}
+
+void PartPrivate::indexRemoved(int i, const QString &title)
+{
+    if (0 == titleIndex) {
+        return;
+    }
+    titleIndex->remove(title, i);
+    for (TitleIndex::iterator it = titleIndex->begin(); it != titleIndex->end(); ++it) {
+        if (it.value() > i) {
+            --it.value();
+        }
+    }
+}
+
 const QString Part::TITLE_KEY("title");
 
 Part::Part(const QString &title, const QString &text, QObject *parent) :
     Attributes(parent), p(new PartPrivate(text))
 {
-    setTitle(title);
+    // new part changes no title index
+    p->title = title;
+    p->hasTitle = true;
 }
 
 Part::Part(const QString &title, FileObject *file, const QByteArray &codec, QObject *parent) :
     Attributes(parent), p(new PartPrivate(file, codec))
 {
-    setTitle(title);
+    // new part changes no title index
+    p->title = title;
+    p->hasTitle = true;
 }
 
 Part::Part(const QString &title, const TextObject &source, QObject *parent) :
     Attributes(parent), p(new PartPrivate(source))
 {
-    setTitle(title);
+    // new part changes no title index
+    p->title = title;
+    p->hasTitle = true;
 }
 
 Part::Part(const Part &other) :
     Attributes(other), QList<Part*>(other), p(new PartPrivate(*other.p))
-{}
+{
+    adoptFields();
+    for (const_iterator i = constBegin(); i != constEnd(); ++i) {
+        (*i)->p->addOwner(this);
+    }
+}
 
 Part::~Part()
 {
+    // leaves lists listing self, then sub-parts
+    while (p->owner != 0) {
+        p->owner->removeAll(this);
+    }
+    for (const_iterator i = constBegin(); i != constEnd(); ++i) {
+        (*i)->p->removeOwner(this);
+    }
     cleanup();
     delete p;
 }
 
 Part& Part::operator =(const Part &other)
 {
+    if (this == &other) {
+        return *this;
+    }
     Attributes::operator =(other);
+    const QList<Part*> parts(*this);
     QList<Part*>::operator =(other);
     *p = *other.p;
+    p->buildIndex(*this);
+    foreach (Part *part, parts) {
+        part->p->removeOwner(this);
+    }
+    for (const_iterator i = constBegin(); i != constEnd(); ++i) {
+        (*i)->p->addOwner(this);
+    }
+    int oldDepth = p->depth, delta = other.p->descendants - p->descendants;
+    p->depth = other.p->depth;
+    p->descendants = other.p->descendants;
+    treeChanged(delta, oldDepth);
     return *this;
 }
 
@@ -99,6 +263,9 @@ bool Part::operator ==(const Part &other) const
 
 QString Part::title() const
 {
+    if (p->hasTitle) {
+        return p->title;
+    }
     const QVariant &v = attribute(TITLE_KEY);
     Q_ASSERT(v.type() == QVariant::String);
     return v.toString();
@@ -109,16 +276,151 @@ void Part::setTitle(const QString &title)
     setAttribute(TITLE_KEY, title);
 }
 
+bool Part::readField(const QString &name, QVariant *value) const
+{
+    if (TITLE_KEY != name || ! p->hasTitle) {
+        return false;
+    }
+    if (value != 0) {
+        *value = p->title;
+    }
+    return true;
+}
+
+bool Part::writeField(const QString &name, const QVariant *value)
+{
+    if (TITLE_KEY != name) {
+        return false;
+    }
+    if (value != 0 && value->type() != QVariant::String) {
+        return false;
+    }
+    QString old = p->title;
+    if (0 == value) {
+        p->hasTitle = false;
+        p->title.clear();
+    } else {
+        p->title = value->toString();
+        p->hasTitle = true;
+    }
+    if (old != p->title) {
+        moveTitleEntries(old);
+    }
+    return true;
+}
+
+void Part::moveTitleEntries(const QString &old)
+{
+    // moves entries of self in title indexes of parts listing self
+    for (int ix = 0; ix < p->ownerCount(); ++ix) {
+        Part *owner = p->ownerAt(ix);
+        PartPrivate::TitleIndex *titles = owner->p->titleIndex;
+        if (0 == titles) {
+            continue;
+        }
+        QList<int> indexes;
+        PartPrivate::TitleIndex::iterator i = titles->find(old);
+        while (i != titles->end() && i.key() == old) {
+            if (owner->at(i.value()) == this) {
+                indexes.append(i.value());
+                i = titles->erase(i);
+            } else {
+                ++i;
+            }
+        }
+        foreach (int index, indexes) {
+            titles->insert(p->title, index);
+        }
+    }
+}
+
+void Part::fieldNames(QStringList &names) const
+{
+    if (p->hasTitle) {
+        names.append(TITLE_KEY);
+    }
+}
+
 QString Part::content() const
 {
     return p->source.text();
 }
 
+const TextObject& Part::source() const
+{
+    return p->source;
+}
+
+QString Part::preview(int maxChars) const
+{
+    return p->source.preview(maxChars);
+}
+
+TextStats Part::stats() const
+{
+    if (! isSection()) {
+        return p->source.stats();
+    }
+    {
+        QMutexLocker locker(statsMutex());
+        if (p->stats != 0) {
+            return *p->stats;
+        }
+    }
+    TextStats result;
+    for (const_iterator i = constBegin(); i != constEnd(); ++i) {
+        result += (*i)->stats();
+    }
+    QMutexLocker locker(statsMutex());
+    if (0 == p->stats) {
+        p->stats = new TextStats(result);
+    }
+    return result;
+}
+
+void Part::dropStats()
+{
+    {
+        QMutexLocker locker(statsMutex());
+        if (0 == p->stats) {
+            return;     // caches of parts listing self are dropped already
+        }
+        delete p->stats;
+        p->stats = 0;
+    }
+    dropOwnerStats();
+}
+
+void Part::dropOwnerStats()
+{
+    for (int ix = 0; ix < p->ownerCount(); ++ix) {
+        p->ownerAt(ix)->dropStats();
+    }
+}
+
+quint64 Part::fingerprint() const
+{
+    if (! isSection()) {
+        return p->source.fingerprint();
+    }
+    QByteArray hashes;
+    QDataStream out(&hashes, QIODevice::WriteOnly);
+    for (const_iterator i = constBegin(); i != constEnd(); ++i) {
+        out << (*i)->fingerprint();
+    }
+    return FileUtils::fingerprint(hashes);
+}
+
 QStringList Part::lines(bool skipEmptyLine) const
 {
     return p->source.lines(skipEmptyLine);
 }
 
+LineReader* Part::lineReader(bool skipEmptyLine) const
+{
+    return p->source.lineReader(skipEmptyLine);
+}
+
 qint64 Part::writeTo(QTextStream &out, qint64 size) const
 {
     return p->source.writeTo(out, size);
@@ -136,6 +438,7 @@ QString Part::text() const
 void Part::setText(const QString &text)
 {
     p->source.setRaw(text);
+    dropOwnerStats();
 }
 
 FileObject* Part::file() const
@@ -145,6 +448,7 @@ FileObject* Part::file() const
 void Part::setFile(FileObject *file, const QByteArray &codec)
 {
     p->source.setFile(file, codec);
+    dropOwnerStats();
 }
 
 QByteArray Part::codec() const
@@ -154,26 +458,85 @@ QByteArray Part::codec() const
 
 int Part::depth() const
 {
-    if (0 == size()) {
-        return 0;
+    return p->depth;
+}
+
+int Part::descendantCount() const
+{
+    return p->descendants;
+}
+
+Part* Part::owner() const
+{
+    return p->owner;
+}
+
+int Part::treeRevision() const
+{
+    return p->revision;
+}
+
+void Part::updateDepth()
+{
+    int depth = 0;
+    for (const_iterator i = constBegin(); i != constEnd(); ++i) {
+        depth = qMax(depth, (*i)->p->depth + 1);
     }
-    int myDepth = 0, maxDepth = 0;
-    for (int ix = 0; ix < size(); ++ix) {
-        const Part *p = get(ix);
-        Q_ASSERT(p != 0);
-        myDepth = p->depth();
-        if (myDepth > maxDepth) {
-            maxDepth = myDepth;
+    p->depth = depth;
+}
+
+void Part::treeChanged(int delta, int oldDepth)
+{
+    ++p->revision;
+    {
+        QMutexLocker locker(statsMutex());
+        delete p->stats;
+        p->stats = 0;
+    }
+    // once for each listing, a part listed twice counts twice
+    for (int ix = 0; ix < p->ownerCount(); ++ix) {
+        Part *owner = p->ownerAt(ix);
+        int ownerDepth = owner->p->depth;
+        owner->p->descendants += delta;
+        if (p->depth + 1 > ownerDepth) {
+            owner->p->depth = p->depth + 1;
+        } else if (p->depth < oldDepth && oldDepth + 1 == ownerDepth) {
+            owner->updateDepth();   // was the deepest, other sub-parts may be as deep
         }
+        owner->treeChanged(delta, ownerDepth);
+    }
+}
+
+void Part::subPartAdded(Part *part)
+{
+    part->p->addOwner(this);
+    int oldDepth = p->depth, delta = part->p->descendants + 1;
+    p->depth = qMax(p->depth, part->p->depth + 1);
+    p->descendants += delta;
+    treeChanged(delta, oldDepth);
+}
+
+void Part::subPartsRemoved(const QList<Part*> &parts)
+{
+    int oldDepth = p->depth, delta = 0;
+    bool deepest = false;
+    foreach (Part *part, parts) {
+        part->p->removeOwner(this);
+        delta -= part->p->descendants + 1;
+        deepest = deepest || part->p->depth + 1 == oldDepth;
     }
-    return maxDepth + 1;
+    p->descendants += delta;
+    if (deepest) {
+        updateDepth();
+    }
+    treeChanged(delta, oldDepth);
 }
 
 Part* Part::newPart(const QString &title, const QString &text)
 {
     Part *part = new Part(title, text, this);
     Q_ASSERT(part != 0);
-    append(part);
+    add(part);
     return part;
 }
 
@@ -181,7 +544,7 @@ Part* Part::newPart(const QString &title, FileObject *file, const QByteArray &co
 {
     Part *part = new Part(title, file, codec, this);
     Q_ASSERT(part != 0);
-    append(part);
+    add(part);
     return part;
 }
 
@@ -189,14 +552,19 @@ Part* Part::newPart(const QString &title, const TextObject &source)
 {
     Part *part = new Part(title, source, this);
     Q_ASSERT(part != 0);
-    append(part);
+    add(part);
     return part;
 }
 
 void Part::set(int i, Part* part)
 {
     Q_ASSERT(part != 0);
-    replace(i, part);
+    Part *old = at(i);
+    QList<Part*>::replace(i, part);
+    p->indexRemoved(i, old->title());
+    p->indexInserted(i, part->title());
+    subPartsRemoved(QList<Part*>() << old);
+    subPartAdded(part);
 }
 
 Part* Part::get(int i, Part* defaultValue) const
@@ -207,7 +575,9 @@ Part* Part::get(int i, Part* defaultValue) const
 void Part::add(Part *const part)
 {
     Q_ASSERT(part != 0);
-    append(part);
+    QList<Part*>::append(part);
+    p->indexInserted(size() - 1, part->title());
+    subPartAdded(part);
 #ifdef QEM_QML_TARGET
     emit sizeChanged(size());
 #endif
@@ -215,29 +585,125 @@ void Part::add(Part *const part)
 
 void Part::remove(int i)
 {
-#ifdef QEM_QML_TARGET
-    int n = size();
-#endif
-    removeAt(i);
-#ifdef QEM_QML_TARGET
-    if (n != size()) {
-        emit sizeChanged(size());
+    if (i < 0 || i >= size()) {
+        return;
     }
+    Part *part = at(i);
+    QList<Part*>::removeAt(i);
+    p->indexRemoved(i, part->title());
+    subPartsRemoved(QList<Part*>() << part);
+#ifdef QEM_QML_TARGET
+    emit sizeChanged(size());
 #endif
 }
 
 void Part::put(int i, Part *part)
 {
     Q_ASSERT(part != 0);
-    insert(i, part);
+    QList<Part*>::insert(i, part);
+    p->indexInserted(i, part->title());
+    subPartAdded(part);
 #ifdef QEM_QML_TARGET
     emit sizeChanged(size());
 #endif
 }
 
+Part* Part::takeAt(int i)
+{
+    Part *part = get(i);
+    remove(i);
+    return part;
+}
+
+bool Part::removeOne(Part *part)
+{
+    int i = QList<Part*>::indexOf(part);
+    if (i < 0) {
+        return false;
+    }
+    remove(i);
+    return true;
+}
+
+int Part::removeAll(Part *part)
+{
+    QList<Part*> parts;
+    for (int ix = size() - 1; ix >= 0; --ix) {
+        if (at(ix) == part) {
+            QList<Part*>::removeAt(ix);
+            p->indexRemoved(ix, part->title());
+            parts.append(part);
+        }
+    }
+    if (! parts.isEmpty()) {
+        subPartsRemoved(parts);
+#ifdef QEM_QML_TARGET
+        emit sizeChanged(size());
+#endif
+    }
+    return parts.size();
+}
+
+void Part::clear()
+{
+    if (isEmpty()) {
+        return;
+    }
+    QList<Part*> parts(*this);
+    QList<Part*>::clear();
+    if (p->titleIndex != 0) {
+        p->titleIndex->clear();
+    }
+    subPartsRemoved(parts);
+#ifdef QEM_QML_TARGET
+    emit sizeChanged(0);
+#endif
+}
+
+void Part::setTitleIndexEnabled(bool enabled)
+{
+    if (enabled && 0 == p->titleIndex) {
+        p->titleIndex = new PartPrivate::TitleIndex();
+        p->buildIndex(*this);
+    } else if (! enabled) {
+        delete p->titleIndex;
+        p->titleIndex = 0;
+    }
+}
+
+bool Part::isTitleIndexEnabled() const
+{
+    return p->titleIndex != 0;
+}
+
+int Part::countOf(const QString &title) const
+{
+    if (isTitleIndexEnabled()) {
+        return p->titleIndex->count(title);
+    }
+    int n = 0;
+    for (int ix = 0; ix < size(); ++ix) {
+        if (title == at(ix)->title()) {
+            ++n;
+        }
+    }
+    return n;
+}
+
 int Part::indexOf(const QString &title, int from) const
 {
     Q_ASSERT(from >= 0 && from < size());
+    if (isTitleIndexEnabled()) {
+        const PartPrivate::TitleIndex *titles = p->titleIndex;
+        int found = -1;
+        PartPrivate::TitleIndex::const_iterator i = titles->constFind(title);
+        for (; i != titles->constEnd() && i.key() == title; ++i) {
+            if (i.value() >= from && (found < 0 || i.value() < found)) {
+                found = i.value();
+            }
+        }
+        return found < 0 ? -1 : found - from;
+    }
     int index = 0;
     for (int ix = from; ix < size(); ++ix) {
         const Part *p = get(ix);
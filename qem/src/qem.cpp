@@ -386,6 +386,11 @@ Book* Qem::readBook(QIODevice &device, const QString &format, const QVariantMap
     Book *book = parser(device, args, error);
     if (book != 0) {
         book->setAttribute("source_format", format);
+        // decoded text cache, budget in bytes
+        qint64 cacheSize = args.value("cache_size").toLongLong();
+        if (cacheSize > 0) {
+            book->setCacheSize(cacheSize);
+        }
     }
     return book;
 }
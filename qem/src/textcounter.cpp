@@ -0,0 +1,101 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "textcounter.h"
+#include "linesplitter.h"
+
+QEM_BEGIN_NAMESPACE
+
+static inline bool isCjk(ushort c)
+{
+    return (c >= 0x4E00 && c <= 0x9FFF) ||      // CJK unified ideographs
+            (c >= 0x3400 && c <= 0x4DBF) ||     // extension A
+            (c >= 0x3040 && c <= 0x30FF) ||     // Hiragana and Katakana
+            (c >= 0xAC00 && c <= 0xD7AF) ||     // Hangul syllables
+            (c >= 0xF900 && c <= 0xFAFF);       // compatibility ideographs
+}
+
+static inline bool isWordChar(ushort c)
+{
+    if (c < 0x80) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+    return QChar(c).isLetterOrNumber();
+}
+
+TextCounter::TextCounter() :
+    m_chars(0), m_breaks(0), m_words(0), m_inWord(false), m_lastCR(false)
+{}
+
+void TextCounter::add(const QString &chunk)
+{
+    const QChar *data = chunk.constData();
+    const int size = chunk.size();
+    m_chars += size;
+    if (0 == size) {
+        return;
+    }
+    // line breaks
+    int i = LineSplitter::indexOfBreak(data, 0, size);
+    if (i != 0 && m_lastCR) {
+        m_lastCR = false;
+    }
+    while (i < size) {
+        if ('\r' == data[i]) {
+            ++m_breaks;
+            m_lastCR = true;
+        } else {
+            if (! m_lastCR) {   // LF not after CR
+                ++m_breaks;
+            }
+            m_lastCR = false;
+        }
+        int next = LineSplitter::indexOfBreak(data, i + 1, size);
+        if (next != i + 1) {
+            m_lastCR = false;
+        }
+        i = next;
+    }
+    // words
+    const ushort *u = reinterpret_cast<const ushort*>(data);
+    for (int j = 0; j < size; ++j) {
+        if (isCjk(u[j])) {
+            ++m_words;
+            m_inWord = false;
+        } else if (isWordChar(u[j])) {
+            if (! m_inWord) {
+                ++m_words;
+                m_inWord = true;
+            }
+        } else {
+            m_inWord = false;
+        }
+    }
+}
+
+TextStats TextCounter::stats(qint64 bytes) const
+{
+    TextStats result;
+    result.chars = m_chars;
+    result.lines = m_breaks + 1;
+    result.words = m_words;
+    result.bytes = bytes;
+    return result;
+}
+
+QEM_END_NAMESPACE
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QEM_TEXTCOUNTER_H
+#define QEM_TEXTCOUNTER_H
+
+#include <textobject.h>
+
+QEM_BEGIN_NAMESPACE
+
+/// Counts TextStats of text given by chunks in one pass.
+/**
+ * Lines are counted like TextObject::lines(), a CR LF split between two
+ * chunks is one line break. A word is a run of letters or digits, each CJK
+ * character is a word.
+ */
+class TextCounter
+{
+public:
+    TextCounter();
+
+    /// Counts next chunk of text.
+    void add(const QString &chunk);
+
+    /// Returns statistics of all text added, \a bytes is stored size of the text.
+    TextStats stats(qint64 bytes) const;
+
+private:
+    qint64 m_chars, m_breaks, m_words;
+    bool m_inWord, m_lastCR;
+};
+
+QEM_END_NAMESPACE
+
+#endif // QEM_TEXTCOUNTER_H
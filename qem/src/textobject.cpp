@@ -18,15 +18,25 @@
 
 #include <fileutils.h>
 #include <textobject.h>
-#include <QRegExp>
+#include <linereader.h>
+#include "linesplitter.h"
+#include "textcounter.h"
+#include <contentcache.h>
 #include <QtDebug>
+#include <QMutex>
+#include <QAtomicInt>
 #include <QVariant>
 #include <QIODevice>
+#include <QTextCodec>
 #include <QTextStream>
+#include <climits>
 
 QEM_BEGIN_NAMESPACE
 
-class TextObjectPrivate
+// guards decoded text of all TextObjects and their use order
+Q_GLOBAL_STATIC(QMutex, decodedMutex)
+
+class TextObjectPrivate : public QSharedData
 {
     friend class TextObject;
 private:
@@ -36,42 +46,387 @@ private:
     QByteArray codec;
     Source source;
 
+    // guards statistics and fingerprint
+    mutable QMutex mutex;
+
+    // decoded text of file, decodedBytes is charged to the global budget,
+    // shared copies of TextObject may decode in different threads, guarded
+    // by decodedMutex and listed from the least recently used
+    mutable QString decoded;
+    mutable bool hasDecoded;
+    mutable int decodedBytes;
+    mutable const TextObjectPrivate *older, *newer;
+
+    // lazily counted statistics
+    mutable TextStats stats;
+    mutable bool hasStats;
+    mutable quint64 fingerprint;
+    mutable bool hasFingerprint;
+
+    static QAtomicInt cacheBudget;
+    static QAtomicInt cachedBytes;
+    static const TextObjectPrivate *oldest, *newest;
+
     inline TextObjectPrivate(const QString &s) :
-        raw(s), file(0), source(Text) {}
+        raw(s), file(0), source(Text), hasDecoded(false), decodedBytes(0), older(0), newer(0),
+        hasStats(false), hasFingerprint(false) {}
 
     inline TextObjectPrivate(FileObject *file, const QByteArray &codec) :
-        file(file), source(File)
+        file(file), source(File), hasDecoded(false), decodedBytes(0), older(0), newer(0),
+        hasStats(false), hasFingerprint(false)
     {
         if (! codec.isEmpty()) {
             this->codec = codec;
         }
     }
+    // used when detaching, decoded text is not copied because the copy
+    // is going to be modified
     inline TextObjectPrivate(const TextObjectPrivate &other) :
-        raw(other.raw), file(other.file), codec(other.codec), source(other.source)
+        QSharedData(other), raw(other.raw), file(other.file), codec(other.codec),
+        source(other.source), hasDecoded(false), decodedBytes(0), older(0), newer(0),
+        hasStats(false), hasFingerprint(false)
     {}
 
-    inline TextObjectPrivate& operator =(const TextObjectPrivate &other)
+    inline ~TextObjectPrivate()
+    {
+        dropDecoded();
+    }
+
+    /// Returns decoded text to \a s if kept, and marks it most recently used.
+    inline bool findDecoded(QString *s) const
+    {
+        QMutexLocker locker(decodedMutex());
+        if (hasDecoded) {
+            *s = decoded;
+            unlink();
+            link();
+        }
+        return hasDecoded;
+    }
+
+    /// Returns UTF-16LE file content mapped in memory to \a s without decoding.
+    /** The string does not own its data, it is valid only while the file lives. */
+    bool findMapped(QString *s) const;
+
+    /// Returns decoded or mapped text to \a s if available without decoding.
+    /** Mapped text is not owned, use it only while the file lives. */
+    inline bool findView(QString *s) const
+    {
+        return findDecoded(s) || findMapped(s);
+    }
+
+    /// Keeps decoded text \a s if it fits in the global budget.
+    /**
+     * Least recently used texts are released to make room. The string is
+     * implicitly shared, copies of a TextObject share its data.
+     */
+    void cacheDecoded(const QString &s) const
+    {
+        int bytes = s.size() * int(sizeof(QChar));
+        QMutexLocker locker(decodedMutex());
+        int budget = cacheBudget.fetchAndAddRelaxed(0);
+        if (hasDecoded || bytes > budget) {
+            return;
+        }
+        evict(budget - bytes);
+        decoded = s;
+        decodedBytes = bytes;
+        hasDecoded = true;
+        cachedBytes.fetchAndAddOrdered(bytes);
+        link();
+    }
+
+    /// Invalidates decoded text.
+    inline void dropDecoded()
+    {
+        QMutexLocker locker(decodedMutex());
+        if (hasDecoded) {
+            release();
+        }
+    }
+
+    /// Releases decoded text, decodedMutex must be locked.
+    void release() const
+    {
+        unlink();
+        cachedBytes.fetchAndAddOrdered(-decodedBytes);
+        decoded.clear();
+        decodedBytes = 0;
+        hasDecoded = false;
+    }
+
+    /// Releases least recently used texts until at most \a bytes are kept.
+    /** decodedMutex must be locked. */
+    static void evict(int bytes)
+    {
+        while (oldest != 0 && cachedBytes.fetchAndAddRelaxed(0) > bytes) {
+            oldest->release();
+        }
+    }
+
+    /// Appends self as the most recently used, decodedMutex must be locked.
+    void link() const
     {
-        raw = other.raw;
-        file = other.file;
-        codec = other.codec;
-        source = other.source;
-        return *this;
+        older = newest;
+        newer = 0;
+        if (newest != 0) {
+            newest->newer = this;
+        } else {
+            oldest = this;
+        }
+        newest = this;
     }
 
-    inline QTextStream* openStream()
+    /// Removes self from the use order, decodedMutex must be locked.
+    void unlink() const
+    {
+        (older != 0 ? older->newer : oldest) = newer;
+        (newer != 0 ? newer->older : newest) = older;
+        older = newer = 0;
+    }
+
+    /// Returns MIB of codec whose bytes can be copied without transcoding, or \c 0.
+    static int passThroughMib(const QByteArray &from, const QByteArray &to);
+
+    /// Copies \a size characters of file bytes in codec \a mib to \a out.
+    /** Returns copied characters number or \c -1 if occurs errors. */
+    qint64 passThrough(QIODevice &out, int mib, qint64 size) const;
+
+    /// Invalidates data derived from text.
+    inline void invalidate()
+    {
+        dropDecoded();
+        QMutexLocker locker(&mutex);
+        hasStats = false;
+        hasFingerprint = false;
+    }
+
+    /// Counts statistics of text.
+    TextStats countStats() const;
+
+    /// Hashes text by chunks.
+    quint64 hashText() const;
+
+    inline QTextStream* openStream() const
     {
         Q_ASSERT(file != 0);
         QIODevice *dev = file->openDevice();
         Q_ASSERT(dev != 0);
         QTextStream *in = new QTextStream(dev);
-        if (! codec.isEmpty()) {
-            in->setCodec(codec.constData());
+        QTextCodec *textCodec = codec.isEmpty() ? 0 : FileUtils::codecForName(codec);
+        if (textCodec != 0) {   // no lookup by name for each stream
+            in->setCodec(textCodec);
         }
         return in;
     }
 };
 
+QAtomicInt TextObjectPrivate::cacheBudget(0);   // disabled by default
+QAtomicInt TextObjectPrivate::cachedBytes(0);
+const TextObjectPrivate *TextObjectPrivate::oldest = 0;
+const TextObjectPrivate *TextObjectPrivate::newest = 0;
+
+// MIB of codecs copied as bytes
+static const int LATIN1_MIB = 4;
+static const int UTF8_MIB = 106;
+static const int UTF16BE_MIB = 1013;
+static const int UTF16LE_MIB = 1014;
+
+static inline QTextCodec* codecOrLocale(const QByteArray &name)
+{
+    return name.isEmpty() ? QTextCodec::codecForLocale() : FileUtils::codecForName(name);
+}
+
+int TextObjectPrivate::passThroughMib(const QByteArray &from, const QByteArray &to)
+{
+    QTextCodec *codec = codecOrLocale(from);
+    if (0 == codec || codec != codecOrLocale(to)) {
+        return 0;
+    }
+    switch (codec->mibEnum()) {
+    case LATIN1_MIB:
+    case UTF8_MIB:
+    case UTF16BE_MIB:
+    case UTF16LE_MIB:
+        return codec->mibEnum();
+    default:    // may have BOM detection or stateful encoding
+        return 0;
+    }
+}
+
+/// Returns size of byte order mark at start of \a data for codec \a mib.
+static int byteOrderMarkSize(int mib, const uchar *data, qint64 size)
+{
+    switch (mib) {
+    case UTF8_MIB:
+        return (size >= 3 && 0xEF == data[0] && 0xBB == data[1] && 0xBF == data[2]) ? 3 : 0;
+    case UTF16LE_MIB:
+        return (size >= 2 && 0xFF == data[0] && 0xFE == data[1]) ? 2 : 0;
+    case UTF16BE_MIB:
+        return (size >= 2 && 0xFE == data[0] && 0xFF == data[1]) ? 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+/// Returns number of UTF-16 characters of UTF-8 bytes.
+static qint64 utf8Length(const uchar *data, qint64 size)
+{
+    qint64 n = 0;
+    for (qint64 i = 0; i < size; ++i) {
+        if ((data[i] & 0xC0) != 0x80) {     // not continuation byte
+            ++n;
+        }
+        if (data[i] >= 0xF0) {      // surrogate pair
+            ++n;
+        }
+    }
+    return n;
+}
+
+bool TextObjectPrivate::findMapped(QString *s) const
+{
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian) {
+        return false;
+    }
+    QTextCodec *textCodec = FileUtils::codecForName(codec);
+    if (0 == textCodec || textCodec->mibEnum() != UTF16LE_MIB) {
+        return false;
+    }
+    const char *data = file->mappedData();
+    qint64 size = file->available();
+    if (0 == data || size < 0 || size / 2 > INT_MAX) {
+        return false;
+    }
+    int skip = byteOrderMarkSize(UTF16LE_MIB, reinterpret_cast<const uchar*>(data), size);
+    // QChar needs aligned data, areas at odd offset are decoded instead
+    if ((reinterpret_cast<quintptr>(data + skip) & 1) != 0) {
+        return false;
+    }
+    *s = QString::fromRawData(reinterpret_cast<const QChar*>(data + skip), int((size - skip) / 2));
+    return true;
+}
+
+qint64 TextObjectPrivate::passThrough(QIODevice &out, int mib, qint64 size) const
+{
+    Q_ASSERT(file != 0);
+    // UTF-8 has no fixed character width, copies all only
+    Q_ASSERT(size < 0 || UTF8_MIB != mib);
+    int width = (LATIN1_MIB == mib) ? 1 : 2;
+    qint64 left = (size < 0) ? -1 : size * width;
+    QIODevice *in = file->openDevice();
+    if (0 == in) {
+        return -1;
+    }
+    const qint64 CHUNK_SIZE = 0x10000;
+    QByteArray buffer(int(CHUNK_SIZE), 0);
+    const uchar *data = reinterpret_cast<const uchar*>(buffer.constData());
+    qint64 n = 0, total = 0;
+    bool first = true;
+    while (left != 0) {
+        // first chunk may start with BOM
+        n = in->read(buffer.data(), (left < 0 || first) ? CHUNK_SIZE : qMin(CHUNK_SIZE, left));
+        if (n <= 0) {
+            break;
+        }
+        int skip = 0;
+        if (first) {    // BOM is not text, QTextStream drops it too
+            first = false;
+            skip = byteOrderMarkSize(mib, data, n);
+        }
+        qint64 bytes = n - skip;
+        if (left >= 0) {
+            bytes = qMin(bytes, left);
+            left -= bytes;
+        }
+        if (out.write(buffer.constData() + skip, bytes) != bytes) {
+            qWarning() << "Cannot write bytes of TextObject:" << out.errorString();
+            total = -1;
+            break;
+        }
+        total += (UTF8_MIB == mib) ? utf8Length(data + skip, bytes) : bytes / width;
+    }
+    if (n < 0 && total >= 0) {
+        qWarning() << "Cannot read bytes of TextObject file:" << in->errorString();
+        total = -1;
+    }
+    delete in;
+    file->reset();
+    return total;
+}
+
+TextStats TextObjectPrivate::countStats() const
+{
+    TextCounter counter;
+    QString str;
+    if (Text == source) {
+        counter.add(raw);
+        return counter.stats(raw.size() * qint64(sizeof(QChar)));
+    } else if (findView(&str)) {
+        counter.add(str);
+    } else {
+        // streams text, the content is never loaded in whole
+        const qint64 CHUNK_SIZE = 0x10000;
+        QTextStream *in = openStream();
+        do {
+            str = in->read(CHUNK_SIZE);
+            counter.add(str);
+        } while (! str.isEmpty());
+        delete in->device();
+        delete in;
+        file->reset();
+    }
+    return counter.stats(file->available());
+}
+
+quint64 TextObjectPrivate::hashText() const
+{
+    QString str;
+    if (Text == source) {
+        return FileUtils::fingerprint(raw);
+    } else if (findView(&str)) {
+        return FileUtils::fingerprint(str);
+    }
+    const qint64 CHUNK_SIZE = 0x10000;
+    quint64 hash = FileUtils::fingerprint(QString());
+    QTextStream *in = openStream();
+    do {
+        str = in->read(CHUNK_SIZE);
+        hash = FileUtils::fingerprint(hash, str);
+    } while (! str.isEmpty());
+    delete in->device();
+    delete in;
+    file->reset();
+    return hash;
+}
+
+/// Reads lines of FileObject by chunks.
+class FileLineReader : public LineReader
+{
+public:
+    inline FileLineReader(FileObject *file, QTextStream *in, bool skipEmptyLine) :
+        LineReader(QString(), skipEmptyLine), m_file(file), m_in(in)
+    {}
+
+    inline ~FileLineReader()
+    {
+        delete m_in->device();
+        delete m_in;
+        m_file->reset();
+    }
+
+protected:
+    inline QString readChunk()
+    {
+        return m_in->read(CHUNK_SIZE);
+    }
+
+private:
+    static const qint64 CHUNK_SIZE = 8192;
+    FileObject *m_file;
+    QTextStream *m_in;
+};
+
 TextObject TextObject::fromQVariant(const QVariant &v, bool *ok)
 {
     if (v.canConvert<TextObject>()) {
@@ -87,8 +442,13 @@ TextObject TextObject::fromQVariant(const QVariant &v, bool *ok)
     }
 }
 
+// shared by all empty TextObjects
+Q_GLOBAL_STATIC_WITH_ARGS(QSharedDataPointer<TextObjectPrivate>, sharedNull,
+                          (new TextObjectPrivate(QString())))
+
 TextObject::TextObject(const QString &s, QObject *parent) :
-    QObject(parent), p(new TextObjectPrivate(s))
+    QObject(parent),
+    p(s.isNull() ? *sharedNull() : QSharedDataPointer<TextObjectPrivate>(new TextObjectPrivate(s)))
 {}
 
 TextObject::TextObject(FileObject *file, const QByteArray &codec, QObject *parent) :
@@ -96,33 +456,56 @@ TextObject::TextObject(FileObject *file, const QByteArray &codec, QObject *paren
 {}
 
 TextObject::TextObject(const TextObject &other) :
-    QObject(other.parent()), p(new TextObjectPrivate(*other.p))
+    QObject(other.parent()), p(other.p)
 {}
 
 TextObject::~TextObject()
-{
-    delete p;
-}
+{}
 
 TextObject& TextObject::operator =(const TextObject &other)
 {
-    *p = *other.p;
+    p = other.p;
     return *this;
 }
 
 bool TextObject::operator ==(const TextObject &other) const
 {
-    if (p->source != other.p->source) {
-        return false;
+    const TextObjectPrivate *d = p.constData(), *o = other.p.constData();
+    if (d == o) {
+        return true;
     }
-    switch (p->source) {
-    case TextObjectPrivate::Text:
-        return p->raw == other.p->raw;
-    case TextObjectPrivate::File:
-        return p->file == other.p->file;
-    default:
+    if (TextObjectPrivate::Text == d->source && TextObjectPrivate::Text == o->source) {
+        return d->raw == o->raw;
+    } else if (TextObjectPrivate::File == d->source && TextObjectPrivate::File == o->source &&
+               d->file == o->file && d->codec == o->codec) {
+        return true;
+    }
+    if (fingerprint() != other.fingerprint()) {
         return false;
     }
+    // same fingerprint is confirmed by bytes of files in same codec without
+    // decoding, or by contents
+    if (TextObjectPrivate::File == d->source && TextObjectPrivate::File == o->source &&
+            d->codec == o->codec && d->file->available() == o->file->available() &&
+            FileUtils::sameContent(*d->file, *o->file)) {
+        return true;
+    }
+    return text() == other.text();
+}
+
+quint64 TextObject::fingerprint() const
+{
+    {
+        QMutexLocker locker(&p->mutex);
+        if (p->hasFingerprint) {
+            return p->fingerprint;
+        }
+    }
+    quint64 hash = p->hashText();
+    QMutexLocker locker(&p->mutex);
+    p->fingerprint = hash;
+    p->hasFingerprint = true;
+    return hash;
 }
 
 QString TextObject::text() const
@@ -135,24 +518,110 @@ QString TextObject::text() const
         break;
     case TextObjectPrivate::File:
     {
+        QString str;
+        if (p->findDecoded(&str)) {
+            return str;
+        }
+        ContentCache *cache = p->file->cache();
+        if (cache != 0 && cache->find(p->file, p->codec, &str)) {
+            return str;
+        }
+        if (p->findMapped(&str)) {
+            // owns a copy, the mapping goes with the file
+            str = QString(str.constData(), str.size());
+        } else {
+            QTextStream *in = p->openStream();
+            str = in->readAll();
+            delete in->device();
+            delete in;
+            p->file->reset();
+        }
+        if (cache != 0) {   // one copy in the book cache only
+            cache->insert(p->file, p->codec, str);
+        } else {
+            p->cacheDecoded(str);
+        }
+        return str;
+    }
+        break;
+    default:
+        return QString();
+    }
+}
+
+QString TextObject::textView() const
+{
+    QString str;
+    if (TextObjectPrivate::File == p->source && p->findMapped(&str)) {
+        return str;
+    }
+    return text();
+}
+
+QString TextObject::preview(int maxChars) const
+{
+    if (maxChars <= 0) {
+        return QString();
+    }
+    switch (p->source) {
+    case TextObjectPrivate::Text:
+        return p->raw.left(maxChars);
+    case TextObjectPrivate::File:
+    {
+        QString str;
+        if (p->findView(&str)) {
+            return QString(str.constData(), qMin(maxChars, str.size()));
+        }
+        ContentCache *cache = p->file->cache();
+        if (cache != 0 && cache->find(p->file, p->codec, &str)) {
+            return str.left(maxChars);
+        }
         QTextStream *in = p->openStream();
-        const QString &str = in->readAll();
+        str = in->read(maxChars);
         delete in->device();
         delete in;
         p->file->reset();
         return str;
     }
-        break;
     default:
         return QString();
     }
 }
 
+TextStats TextObject::stats() const
+{
+    {
+        QMutexLocker locker(&p->mutex);
+        if (p->hasStats) {
+            return p->stats;
+        }
+    }
+    // counts without lock, the result is same in any thread
+    const TextStats &stats = p->countStats();
+    QMutexLocker locker(&p->mutex);
+    p->stats = stats;
+    p->hasStats = true;
+    return stats;
+}
+
 QStringList TextObject::lines(bool skipEmptyLine) const
 {
+    return LineSplitter::split(text(), skipEmptyLine);
+}
 
-    return text().split(QRegExp("(\\r\\n|\\r|\\n)"),
-                        skipEmptyLine ? QString::SkipEmptyParts : QString::KeepEmptyParts);
+LineReader* TextObject::lineReader(bool skipEmptyLine) const
+{
+    if (TextObjectPrivate::File == p->source) {
+        ContentCache *cache = p->file->cache();
+        QString str;
+        if (p->findView(&str)) {
+            return new LineReader(str, skipEmptyLine);
+        } else if (cache != 0 && cache->find(p->file, p->codec, &str)) {
+            return new LineReader(str, skipEmptyLine);
+        }
+        return new FileLineReader(p->file, p->openStream(), skipEmptyLine);
+    }
+    return new LineReader(p->raw, skipEmptyLine);
 }
 
 qint64 TextObject::writeTo(QTextStream &out, qint64 size) const
@@ -171,6 +640,12 @@ qint64 TextObject::writeTo(QTextStream &out, qint64 size) const
         break;
     case TextObjectPrivate::File:
     {
+        QString str;
+        if (p->findView(&str)) {
+            total = (size < 0) ? str.size() : qMin(qint64(str.size()), size);
+            out << str.left(total);
+            break;
+        }
         QTextStream *in = p->openStream();
         total = FileUtils::copy(*in, out, size);
         delete in->device();
@@ -185,9 +660,19 @@ qint64 TextObject::writeTo(QTextStream &out, qint64 size) const
 
 qint64 TextObject::writeTo(QIODevice &out, const QByteArray &encoding, qint64 size) const
 {
+    if (TextObjectPrivate::File == p->source) {
+        // same codec, copies bytes without decoding and encoding
+        int mib = TextObjectPrivate::passThroughMib(p->codec, encoding);
+        if (mib != 0 && (size < 0 || mib != UTF8_MIB)) {
+            return p->passThrough(out, mib, size);
+        }
+    }
     QTextStream stream(&out);
     if (! encoding.isEmpty()) {
-        stream.setCodec(encoding.constData());
+        QTextCodec *codec = FileUtils::codecForName(encoding);
+        if (codec != 0) {
+            stream.setCodec(codec);
+        }
     }
     return writeTo(stream, size);
 }
@@ -199,6 +684,7 @@ const QString& TextObject::raw() const
 
 void TextObject::setRaw(const QString &s)
 {
+    p->invalidate();
     p->source = TextObjectPrivate::Text;
     p->raw = s;
 }
@@ -216,14 +702,35 @@ QByteArray TextObject::codec() const
 void TextObject::setFile(FileObject *file, const QByteArray &codec)
 {
     Q_ASSERT(file != 0);
-    p->source = TextObjectPrivate::File;
-    if (p->file == file) {
-        return;
+    const TextObjectPrivate *d = p.constData();
+    if (TextObjectPrivate::File == d->source && d->file == file &&
+            (codec.isEmpty() || codec == d->codec)) {
+        return;     // keeps sharing and decoded text
     }
+    p->invalidate();
+    p->source = TextObjectPrivate::File;
     p->file = file;
     if (! codec.isEmpty()) {
         p->codec = codec;
     }
 }
 
+int TextObject::cacheBudget()
+{
+    return TextObjectPrivate::cacheBudget.fetchAndAddRelaxed(0);
+}
+
+void TextObject::setCacheBudget(int bytes)
+{
+    QMutexLocker locker(decodedMutex());
+    bytes = qMax(bytes, 0);
+    TextObjectPrivate::cacheBudget.fetchAndStoreOrdered(bytes);
+    TextObjectPrivate::evict(bytes);
+}
+
+int TextObject::cachedBytes()
+{
+    return TextObjectPrivate::cachedBytes.fetchAndAddRelaxed(0);
+}
+
 QEM_END_NAMESPACE
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2014-2015 Peng Wan
+ *
+ * This file is part of Qem.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <tocindex.h>
+#include <part.h>
+#include <QHash>
+#include <QVector>
+#include <QtAlgorithms>
+
+QEM_BEGIN_NAMESPACE
+
+class TocIndexPrivate
+{
+    friend class TocIndex;
+private:
+    inline TocIndexPrivate(const Part *root) :
+        root(root), built(false), revision(0)
+    {}
+
+    /// Builds index if stale.
+    inline void update()
+    {
+        if (! built || revision != root->treeRevision()) {
+            build();
+        }
+    }
+
+    void build();
+
+    /// Appends sub-parts of \a owner with parent \a parent to entries.
+    void append(const Part &owner, int parent, int depth);
+
+    /// Compares path of entry at \a ordinal with \a path.
+    /** Returns negative, zero or positive if the entry path is less, equal or greater. */
+    int compare(int ordinal, const QList<int> &path) const;
+
+    const Part *root;
+    bool built;
+    int revision;
+    QVector<TocIndex::Entry> entries;
+    QVector<int> chapters;     // ordinals of leaf parts
+    QHash<const Part*, int> ordinals;
+};
+
+void TocIndexPrivate::build()
+{
+    revision = root->treeRevision();
+    entries.clear();
+    chapters.clear();
+    ordinals.clear();
+    int count = root->descendantCount();
+    entries.reserve(count);
+    ordinals.reserve(count);
+    append(*root, -1, 0);
+    built = true;
+}
+
+void TocIndexPrivate::append(const Part &owner, int parent, int depth)
+{
+    for (int ix = 0; ix < owner.size(); ++ix) {
+        Part *part = owner.at(ix);
+        Q_ASSERT(part != 0);
+        int ordinal = entries.size();
+        TocIndex::Entry entry = {part, parent, depth, ix, ordinal + 1};
+        entries.append(entry);
+        ordinals.insert(part, ordinal);
+        if (part->isSection()) {
+            append(*part, ordinal, depth + 1);
+            entries[ordinal].end = entries.size();
+        } else {
+            chapters.append(ordinal);
+        }
+    }
+}
+
+int TocIndexPrivate::compare(int ordinal, const QList<int> &path) const
+{
+    const TocIndex::Entry &entry = entries.at(ordinal);
+    QVector<int> indexes(entry.depth + 1);
+    for (int i = ordinal; i != -1; i = entries.at(i).parent) {
+        indexes[entries.at(i).depth] = entries.at(i).index;
+    }
+    int n = qMin(indexes.size(), path.size());
+    for (int i = 0; i < n; ++i) {
+        if (indexes.at(i) != path.at(i)) {
+            return indexes.at(i) < path.at(i) ? -1 : 1;
+        }
+    }
+    // prefix is less in preorder
+    return indexes.size() - path.size();
+}
+
+TocIndex::TocIndex(const Part *root) :
+    p(new TocIndexPrivate(root))
+{
+    Q_ASSERT(root != 0);
+}
+
+TocIndex::~TocIndex()
+{
+    delete p;
+}
+
+const Part* TocIndex::root() const
+{
+    return p->root;
+}
+
+bool TocIndex::isStale() const
+{
+    return ! p->built || p->revision != p->root->treeRevision();
+}
+
+void TocIndex::rebuild()
+{
+    p->build();
+}
+
+int TocIndex::size() const
+{
+    p->update();
+    return p->entries.size();
+}
+
+const TocIndex::Entry& TocIndex::entry(int ordinal) const
+{
+    p->update();
+    Q_ASSERT(ordinal >= 0 && ordinal < p->entries.size());
+    return p->entries.at(ordinal);
+}
+
+Part* TocIndex::part(int ordinal) const
+{
+    p->update();
+    if (ordinal < 0 || ordinal >= p->entries.size()) {
+        return 0;
+    }
+    return p->entries.at(ordinal).part;
+}
+
+QList<int> TocIndex::path(int ordinal) const
+{
+    p->update();
+    QList<int> result;
+    if (ordinal < 0 || ordinal >= p->entries.size()) {
+        return result;
+    }
+    for (int i = ordinal; i != -1; i = p->entries.at(i).parent) {
+        result.prepend(p->entries.at(i).index);
+    }
+    return result;
+}
+
+int TocIndex::ordinalOf(const QList<int> &path) const
+{
+    p->update();
+    if (path.isEmpty()) {
+        return -1;
+    }
+    // preorder is ordered by path
+    int low = 0, high = p->entries.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (p->compare(middle, path) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < p->entries.size() && 0 == p->compare(low, path)) {
+        return low;
+    }
+    return -1;
+}
+
+int TocIndex::ordinalOf(const Part *part) const
+{
+    p->update();
+    return p->ordinals.value(part, -1);
+}
+
+int TocIndex::chapterCount() const
+{
+    p->update();
+    return p->chapters.size();
+}
+
+int TocIndex::chapterAt(int n) const
+{
+    p->update();
+    return p->chapters.value(n, -1);
+}
+
+int TocIndex::nextChapter(int ordinal) const
+{
+    p->update();
+    QVector<int>::const_iterator i = qUpperBound(p->chapters.constBegin(), p->chapters.constEnd(),
+                                                 ordinal);
+    return i != p->chapters.constEnd() ? *i : -1;
+}
+
+int TocIndex::previousChapter(int ordinal) const
+{
+    p->update();
+    QVector<int>::const_iterator i = qLowerBound(p->chapters.constBegin(), p->chapters.constEnd(),
+                                                 ordinal);
+    return i != p->chapters.constBegin() ? *(i - 1) : -1;
+}
+
+QEM_END_NAMESPACE
@@ -38,7 +38,7 @@ else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../qem/debug/ -lqem
 else:symbian: LIBS += -lqem
 else:unix: LIBS += -L$$OUT_PWD/../qem/ -lqem
 
-INCLUDEPATH += $$PWD/../qem/include
+INCLUDEPATH += $$PWD/../qem/include $$PWD/../qem/src
 DEPENDPATH += $$PWD/../qem
 
 win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../3rdparty/quazip/release/ -lquazip
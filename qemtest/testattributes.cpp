@@ -18,9 +18,25 @@
 
 #include "testattributes.h"
 #include <attributes.h>
+#include <book.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 QEM_USE_NAMESPACE
 
+// Returns bytes in use of the heap of main thread, or -1 if unknown.
+static qint64 heapBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return qint64(mallinfo2().uordblks);
+#elif defined(__GLIBC__)
+    return qint64(mallinfo().uordblks);
+#else
+    return -1;
+#endif
+}
+
 TestAttributes::TestAttributes()
 {
 }
@@ -63,6 +79,147 @@ void TestAttributes::removeAttribute()
     QVERIFY(attr.attributeCount() == 0);
 }
 
+void TestAttributes::typedFields()
+{
+    Book book("Title", "Author");
+    connect(&book, SIGNAL(attributeChanged(QString,QVariant)), this, SLOT(onChange(QString,QVariant)));
+    connect(&book, SIGNAL(attributeRemoved(QString)), this, SLOT(onRemove(QString)));
+    book.setAttribute("Name", "PW");
+    book.setCover(0);
+    QStringList names = book.attributeNames();
+    QCOMPARE(book.attributeCount(), names.size());
+    QVERIFY(names.contains("title"));
+    QVERIFY(names.contains("author"));
+    QVERIFY(names.contains("date"));
+    QVERIFY(names.contains("cover"));
+    QVERIFY(names.contains("Name"));
+    QStringList sorted = names;
+    sorted.sort();
+    QCOMPARE(names, sorted);
+    QCOMPARE(book.attribute("author").toString(), QString("Author"));
+    QCOMPARE(book.attribute("title").toString(), QString("Title"));
+
+    // same value is not changed
+    reset();
+    book.setAuthor("Author");
+    QVERIFY(m_name.isEmpty());
+    book.setAttribute("author", "PW");
+    QCOMPARE(m_name, QString("author"));
+    QCOMPARE(book.author(), QString("PW"));
+
+    // value of other type is kept as attribute
+    book.setAttribute("author", 1);
+    QCOMPARE(book.attribute("author"), QVariant(1));
+    QCOMPARE(book.attributeNames(), names);
+    book.setAuthor("PW");
+    QCOMPARE(book.author(), QString("PW"));
+
+    reset();
+    book.removeAttribute("author");
+    QCOMPARE(m_name, QString("author"));
+    QVERIFY(! book.hasAttribute("author"));
+    QVERIFY(! book.attribute("author").isValid());
+    QCOMPARE(book.attributeCount(), names.size() - 1);
+    reset();
+    book.removeAttribute("author");
+    QVERIFY(m_name.isEmpty());
+
+    Book copy(book);
+    QCOMPARE(copy.attributeNames(), book.attributeNames());
+    QCOMPARE(copy.title(), QString("Title"));
+    QCOMPARE(copy.attribute("Name").toString(), QString("PW"));
+    Part part(book);
+    QCOMPARE(part.attributeNames(), book.attributeNames());
+    QCOMPARE(part.attribute("date"), book.attribute("date"));
+}
+
+void TestAttributes::assignFields()
+{
+    Chapter chapter("Chapter", "Text", 0, TextObject("Intro"));
+    Chapter other("Other", "Text", 0, TextObject("Other intro"));
+    other = chapter;
+    QCOMPARE(other.title(), QString("Chapter"));
+    QCOMPARE(other.introText(), QString("Intro"));
+    chapter.setIntroText("Changed");
+    QCOMPARE(other.introText(), QString("Intro"));
+    Chapter empty;
+    other = empty;
+    QCOMPARE(other.introText(), QString());
+
+    Book book("Title", "Author"), copy;
+    book.setCacheSize(1024);
+    book.setItem("Name", "PW");
+    copy = book;
+    QCOMPARE(copy.author(), QString("Author"));
+    QCOMPARE(copy.getItem("Name").toString(), QString("PW"));
+    QVERIFY(copy.contentCache() == 0);
+    copy.setCacheSize(2048);
+    QVERIFY(copy.contentCache() != book.contentCache());
+}
+
+void TestAttributes::atoms()
+{
+    int atom = Attributes::atomOf("atom-name");
+    QVERIFY(atom >= 0);
+    QCOMPARE(Attributes::atomOf("atom-name"), atom);
+    QCOMPARE(Attributes::atomOf(QString("atom-") + "name", false), atom);
+    QCOMPARE(Attributes::nameOf(atom), QString("atom-name"));
+    QVERIFY(Attributes::atomOf("atom-other") != atom);
+    QCOMPARE(Attributes::atomOf("atom-missing", false), -1);
+    QVERIFY(Attributes::nameOf(-1).isNull());
+
+    Attributes attr;
+    attr.setAttribute("b", 2);
+    attr.setAttribute("c", 3);
+    attr.setAttribute("a", 1);
+    QCOMPARE(attr.attributeNames(), QStringList() << "a" << "b" << "c");
+    attr.setAttribute("b", 4);
+    QCOMPARE(attr.attributeCount(), 3);
+    QCOMPARE(attr.attribute("b").toInt(), 4);
+    attr.removeAttribute("c");
+    QCOMPARE(attr.attributeNames(), QStringList() << "a" << "b");
+    QVERIFY(! attr.attribute("c").isValid());
+}
+
+void TestAttributes::memoryBenchmark()
+{
+    const int count = 10000;
+    if (heapBytes() < 0) {
+        QSKIP("Heap usage is unknown", SkipSingle);
+    }
+    const QString value("value");
+
+    // before atoms each chapter kept its own map, keys parsed for each chapter
+    QVector<QVariantMap> maps(count);
+    qint64 start = heapBytes();
+    for (int i = 0; i < count; ++i) {
+        QVariantMap &map = maps[i];
+        map.insert(QString::fromLatin1("source"), value);
+        map.insert(QString::fromLatin1("id"), i);
+        map.insert(QString::fromLatin1("note"), value);
+    }
+    qint64 mapBytes = heapBytes() - start;
+
+    Book book;
+    book.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        book.newChapter(value);
+    }
+    start = heapBytes();
+    for (int i = 0; i < count; ++i) {
+        Part *chapter = book.at(i);
+        chapter->setAttribute(QString::fromLatin1("source"), value);
+        chapter->setAttribute(QString::fromLatin1("id"), i);
+        chapter->setAttribute(QString::fromLatin1("note"), value);
+    }
+    qint64 attributeBytes = heapBytes() - start;
+
+    qDebug() << "attribute bytes per chapter, map:" << mapBytes / count
+             << "atoms:" << attributeBytes / count;
+    // keys are interned once, no key string nor map node kept by chapters
+    QVERIFY(attributeBytes < mapBytes);
+}
+
 void TestAttributes::onChange(const QString &name, const QVariant &v)
 {
     qDebug() << "change attr";
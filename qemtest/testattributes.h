@@ -38,6 +38,10 @@ private slots:
     void setAttribute();
     void getAttribute();
     void removeAttribute();
+    void typedFields();
+    void assignFields();
+    void atoms();
+    void memoryBenchmark();
 private:
     inline void reset()
     {
@@ -18,6 +18,10 @@
 
 #include "testfileobject.h"
 #include <filefactory.h>
+#include <fileutils.h>
+#include <book.h>
+#include <formats/epub.h>
+#include <formats/epub/writer.h>
 #include <QDir>
 #include <QFile>
 #include <QBuffer>
@@ -27,6 +31,21 @@
 
 QEM_USE_NAMESPACE
 
+/// Exposes image writing of EPUB writer.
+class ImageWriter : public epub::EpubWriterV2
+{
+public:
+    inline ImageWriter(const Book &book, QuaZip &zip) :
+        EpubWriterV2(book, zip, epub::EPUB::DefaultMakeConfig, 0)
+    {}
+
+    using EpubWriter::writeImage;
+
+    inline int manifestCount() const
+    {
+        return manifestItems.size();
+    }
+};
 
 TestFileObject::TestFileObject(){
 }
@@ -51,6 +70,7 @@ void TestFileObject::testNormalFile()
     QVERIFY(bf != 0);
     QCOMPARE(bf->name(), name);
     QCOMPARE(bf->mime(), QString("text/plain"));
+    QCOMPARE(bf->available(), qint64(data.size()));
     QByteArray buf;
     READ_ALL(bf, buf);
     QCOMPARE(buf, data);
@@ -66,6 +86,31 @@ void TestFileObject::testNormalFile()
     curDir.remove(file.fileName());
 }
 
+void TestFileObject::testMappedFile()
+{
+    QDir curDir;
+    QString name("temp.txt");
+    QFile file(name);
+    QVERIFY(file.open(QFile::WriteOnly));
+    const QByteArray data("write some bytes");
+    file.write(data);
+    file.close();
+    FileObject *bf = FileFactory::getFile(name, "", 0, true);
+    QVERIFY(bf != 0);
+    const QByteArray all = bf->readAll();
+    QCOMPARE(all, data);
+    QByteArray buf;
+    READ_ALL(bf, buf);
+    QCOMPARE(buf, data);
+    QIODevice *dev = bf->openDevice();
+    QVERIFY(dev != 0);
+    delete bf;
+    QCOMPARE(all, data);                // owned copy outlives the mapping
+    QCOMPARE(dev->readAll(), data);     // mapping lives with the device
+    delete dev;
+    curDir.remove(file.fileName());
+}
+
 void TestFileObject::testPartFile()
 {
     QDir curDir;
@@ -77,6 +122,7 @@ void TestFileObject::testPartFile()
     QVERIFY(file.seek(0));
     FileObject *bf = FileFactory::getFile(file.fileName(), &file, 6, 4, 0);
     QVERIFY(bf != 0);
+    QCOMPARE(bf->available(), qint64(4));
     QByteArray buf;
     READ_ALL(bf, buf);
     qDebug() << buf.size();
@@ -93,6 +139,122 @@ void TestFileObject::testPartFile()
     curDir.remove(file.fileName());
 }
 
+void TestFileObject::testAreaDevice()
+{
+    QBuffer buffer;
+    buffer.setData("0123456789abcdef");
+    QVERIFY(buffer.open(QBuffer::ReadOnly));
+    QVERIFY(buffer.seek(1));
+    FileObject *bf = FileFactory::getFile("area", &buffer, 4, 8);
+    QVERIFY(bf != 0);
+    QIODevice *dev = bf->openDevice();
+    QVERIFY(dev != 0);
+    QVERIFY(! dev->isSequential());
+    QCOMPARE(dev->size(), qint64(8));
+    QCOMPARE(dev->read(3), QByteArray("456"));
+    QCOMPARE(dev->pos(), qint64(3));
+    QVERIFY(! dev->atEnd());
+    // reads stop at the end of the area
+    QVERIFY(dev->seek(6));
+    QCOMPARE(dev->read(10), QByteArray("ab"));
+    QVERIFY(dev->atEnd());
+    QCOMPARE(dev->read(1), QByteArray());
+    QVERIFY(dev->seek(0));
+    QVERIFY(! dev->atEnd());
+    QCOMPARE(dev->read(8), QByteArray("456789ab"));
+    QVERIFY(dev->atEnd());
+    QVERIFY(dev->seek(7));
+    QCOMPARE(dev->read(1), QByteArray("b"));
+    QVERIFY(dev->atEnd());
+    // position of the parent device is never moved
+    QCOMPARE(buffer.pos(), qint64(1));
+    delete dev;
+    bf->reset();
+    delete bf;
+
+    // area at the end of the parent device
+    bf = FileFactory::getFile("tail", &buffer, 12, 4);
+    QVERIFY(bf != 0);
+    dev = bf->openDevice();
+    QVERIFY(dev != 0);
+    QCOMPARE(dev->readAll(), QByteArray("cdef"));
+    QVERIFY(dev->atEnd());
+    delete dev;
+    bf->reset();
+    delete bf;
+    buffer.close();
+}
+
+void TestFileObject::testReadAt()
+{
+    QDir curDir;
+    QString name("temp.txt");
+    QFile file(name);
+    QVERIFY(file.open(QFile::ReadWrite));
+    QByteArray data("write some bytes");
+    file.write(data);
+    QVERIFY(file.seek(2));
+    FileObject *bf = FileFactory::getFile(file.fileName(), &file, 6, 10, 0);
+    QVERIFY(bf != 0);
+    QCOMPARE(bf->readAt(5, 3), QByteArray("byt"));
+    QCOMPARE(bf->readAt(8, 100), QByteArray("es"));
+    QCOMPARE(bf->readAt(10, 1), QByteArray());
+    QCOMPARE(bf->readAt(0, -1), QByteArray());
+    QIODevice *dev = bf->openDevice();
+    QVERIFY(dev != 0);
+    QCOMPARE(dev->read(4), QByteArray("some"));
+    delete dev;
+    QCOMPARE(file.pos(), qint64(2));   // position of shared device is kept
+    delete bf;
+    file.close();
+    curDir.remove(file.fileName());
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QBuffer::ReadOnly));
+    bf = FileFactory::getFile("buffer", &buffer, 0, data.size(), 0);
+    QVERIFY(bf != 0);
+    QCOMPARE(bf->readAt(6, 4), QByteArray("some"));
+    QCOMPARE(buffer.pos(), qint64(0));
+    delete bf;
+}
+
+void TestFileObject::testAsync()
+{
+    QDir curDir;
+    QString name("temp.txt");
+    QFile file(name);
+    QVERIFY(file.open(QFile::WriteOnly));
+    const QByteArray data("write some bytes");
+    file.write(data);
+    file.close();
+    FileObject *bf = FileFactory::getFile(name);
+    QVERIFY(bf != 0);
+    QFuture<QByteArray> future = bf->readAllAsync();
+    future.waitForFinished();
+    QCOMPARE(future.result(), data);
+    QBuffer buffer;
+    QVERIFY(buffer.open(QBuffer::ReadWrite));
+    QFuture<qint64> copied = bf->copyToAsync(&buffer, 5);
+    copied.waitForFinished();
+    QCOMPARE(copied.result(), qint64(5));
+    QCOMPARE(buffer.data(), QByteArray("write"));
+    delete bf;
+    curDir.remove(name);
+}
+
+void TestFileObject::testFingerprint()
+{
+    QCOMPARE(FileUtils::fingerprint(QByteArray()), Q_UINT64_C(0xcbf29ce484222325));
+    QCOMPARE(FileUtils::fingerprint(QByteArray("a")), Q_UINT64_C(0xaf63dc4c8601ec8c));
+    QByteArray data("write some bytes");
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QBuffer::ReadOnly));
+    FileObject *bf = FileFactory::getFile("buffer", &buffer, 6, 4, 0);
+    QVERIFY(bf != 0);
+    QCOMPARE(bf->fingerprint(), FileUtils::fingerprint(QByteArray("some")));
+    delete bf;
+}
+
 void TestFileObject::testZipFile()
 {
     QDir curDir;
@@ -102,14 +264,152 @@ void TestFileObject::testZipFile()
     QuaZipNewInfo zipInfo("A.txt");
     QVERIFY(file.open(QuaZipFile::WriteOnly, zipInfo));
     file.write("Hellow");
+    file.close();
+    QVERIFY(file.open(QuaZipFile::WriteOnly, QuaZipNewInfo("B.txt")));
+    file.write("World");
     zip.close();
     QVERIFY(zip.open(QuaZip::mdUnzip));
     FileObject *fb = FileFactory::getFile(&zip, "A.txt");
     QVERIFY(fb != 0);
+    FileObject *fb2 = FileFactory::getFile(&zip, "B.txt");
+    QVERIFY(fb2 != 0);
+    QVERIFY(FileFactory::getFile(&zip, "C.txt") == 0);
+    QCOMPARE(fb2->available(), qint64(5));
+    QCOMPARE(fb2->readAll(), QByteArray("World"));
+    QIODevice *dev1 = fb->openDevice(), *dev2 = fb2->openDevice();     // independent handles
+    QVERIFY(dev1 != 0 && dev2 != 0);
+    QCOMPARE(dev2->read(3), QByteArray("Wor"));
+    QCOMPARE(dev1->readAll(), QByteArray("Hellow"));
+    QCOMPARE(dev2->readAll(), QByteArray("ld"));
+    delete dev1;
+    delete dev2;
     QByteArray ba;
+    READ_ALL(fb2, ba);
+    QCOMPARE(ba, QByteArray("World"));
     READ_ALL(fb, ba);
     QCOMPARE(ba, QByteArray("Hellow"));
+    // compressed entries are read forward to the offset
+    QCOMPARE(fb->readAt(2, 3), QByteArray("llo"));
+    QCOMPARE(fb->readAt(4, 100), QByteArray("ow"));
+    QCOMPARE(fb->readAt(6, 1), QByteArray());
+    QCOMPARE(fb->readAt(100, 1), QByteArray());
     delete fb;
+    delete fb2;
     zip.close();
     curDir.remove("tmp.zip");
 }
+
+void TestFileObject::testStoredZipFile()
+{
+    QBuffer buffer;
+    QuaZip zip(&buffer);
+    QVERIFY(zip.open(QuaZip::mdCreate));
+    QuaZipFile file(&zip);
+    QVERIFY(file.open(QuaZipFile::WriteOnly, QuaZipNewInfo("S.txt"), 0, 0, 0));   // stored
+    file.write("Stored bytes");
+    file.close();
+    zip.close();
+    QVERIFY(zip.open(QuaZip::mdUnzip));
+    FileObject *fb = FileFactory::getFile(&zip, "S.txt");
+    QVERIFY(fb != 0);
+    QCOMPARE(fb->readAll(), QByteArray("Stored bytes"));
+    QCOMPARE(fb->readAt(7, 5), QByteArray("bytes"));
+    delete fb;
+    zip.close();
+
+    // bytes before the archive, such as a SFX stub
+    QBuffer prefixed;
+    prefixed.setData(QByteArray("stub") + buffer.data());
+    QuaZip sfx(&prefixed);
+    QVERIFY(sfx.open(QuaZip::mdUnzip));
+    fb = FileFactory::getFile(&sfx, "S.txt");
+    QVERIFY(fb != 0);
+    QCOMPARE(fb->readAll(), QByteArray("Stored bytes"));
+    QVERIFY(fb->mappedData() != 0);
+    QCOMPARE(QByteArray(fb->mappedData(), 6), QByteArray("Stored"));
+    delete fb;
+    sfx.close();
+
+    // files read the archive by own handles after it is released and deleted
+    QBuffer *source = new QBuffer;
+    source->setData(buffer.data());
+    QuaZip *released = new QuaZip(source);
+    QVERIFY(released->open(QuaZip::mdUnzip));
+    fb = FileFactory::getFile(released, "S.txt");
+    QVERIFY(fb != 0);
+    FileFactory::releaseZip(released);
+    released->close();
+    delete released;
+    delete source;
+    QCOMPARE(fb->readAll(), QByteArray("Stored bytes"));
+    QCOMPARE(fb->readAt(7, 5), QByteArray("bytes"));
+    delete fb;
+}
+
+void TestFileObject::testUniqueEpubImage()
+{
+    QByteArray data1("same cover"), data2("same cover");
+    QBuffer buffer1(&data1), buffer2(&data2);
+    QVERIFY(buffer1.open(QBuffer::ReadOnly));
+    QVERIFY(buffer2.open(QBuffer::ReadOnly));
+    FileObject *cover1 = FileFactory::getFile("a/cover.jpg", &buffer1, 0, data1.size(), "image/jpeg");
+    FileObject *cover2 = FileFactory::getFile("b/cover.jpg", &buffer2, 0, data2.size(), "image/jpeg");
+    QVERIFY(cover1 != 0 && cover2 != 0);
+    QBuffer epub;
+    QuaZip zip(&epub);
+    QVERIFY(zip.open(QuaZip::mdCreate));
+    Book book;
+    ImageWriter writer(book, zip);
+    const QString &href = writer.writeImage(*cover1, epub::EPUB::CoverFileID);
+    QVERIFY(! href.isEmpty());
+    QCOMPARE(writer.writeImage(*cover2), href);
+    QCOMPARE(writer.manifestCount(), 1);
+    zip.close();
+    QVERIFY(zip.open(QuaZip::mdUnzip));
+    QCOMPARE(zip.getEntriesCount(), 1);
+    zip.close();
+    delete cover1;
+    delete cover2;
+}
+
+void TestFileObject::testUniqueCompressedImage()
+{
+    // compressed entries larger than one compare chunk
+    QByteArray data;
+    for (int i = 0; i < 100 * 1024; ++i) {
+        data.append(char(i % 251));
+    }
+    QBuffer source;
+    QuaZip images(&source);
+    QVERIFY(images.open(QuaZip::mdCreate));
+    QuaZipFile file(&images);
+    QVERIFY(file.open(QuaZipFile::WriteOnly, QuaZipNewInfo("a/cover.jpg")));
+    file.write(data);
+    file.close();
+    QVERIFY(file.open(QuaZipFile::WriteOnly, QuaZipNewInfo("b/cover.jpg")));
+    file.write(data);
+    file.close();
+    images.close();
+    QVERIFY(images.open(QuaZip::mdUnzip));
+    FileObject *cover1 = FileFactory::getFile(&images, "a/cover.jpg", "image/jpeg");
+    FileObject *cover2 = FileFactory::getFile(&images, "b/cover.jpg", "image/jpeg");
+    QVERIFY(cover1 != 0 && cover2 != 0);
+    QCOMPARE(cover1->fingerprint(), cover2->fingerprint());
+    QBuffer epub;
+    QuaZip zip(&epub);
+    QVERIFY(zip.open(QuaZip::mdCreate));
+    Book book;
+    ImageWriter writer(book, zip);
+    const QString &href = writer.writeImage(*cover1, epub::EPUB::CoverFileID);
+    QVERIFY(! href.isEmpty());
+    QCOMPARE(writer.writeImage(*cover2), href);
+    QCOMPARE(writer.manifestCount(), 1);
+    zip.close();
+    QVERIFY(zip.open(QuaZip::mdUnzip));
+    QCOMPARE(zip.getEntriesCount(), 1);
+    zip.close();
+    delete cover1;
+    delete cover2;
+    FileFactory::releaseZip(&images);
+    images.close();
+}
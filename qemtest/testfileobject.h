@@ -31,8 +31,16 @@ signals:
     
 private slots:
     void testNormalFile();
+    void testMappedFile();
     void testPartFile();
+    void testAreaDevice();
+    void testReadAt();
+    void testAsync();
+    void testFingerprint();
     void testZipFile();
+    void testStoredZipFile();
+    void testUniqueEpubImage();
+    void testUniqueCompressedImage();
     
 };
 
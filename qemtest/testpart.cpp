@@ -18,6 +18,7 @@
 
 #include "testpart.h"
 #include <book.h>
+#include <tocindex.h>
 #include <QBuffer>
 #include <QString>
 #include <QTextStream>
@@ -115,6 +116,249 @@ void TestPart::indexPart()
     QVERIFY(ls.size() == 6);
 }
 
+void TestPart::testTitleIndex()
+{
+    Book book("Example", "PW");
+    book.setTitleIndexEnabled(true);
+    QVERIFY(book.isTitleIndexEnabled());
+    for (int i = 0; i < 100; ++i) {
+        book.newPart(QString("Part %1").arg(i % 50), "Hello");
+    }
+    QCOMPARE(book.indexOf("Part 7"), 7);
+    QCOMPARE(book.indexOf("Part 7", 8), 49);     // offset from 8
+    QCOMPARE(book.countOf("Part 7"), 2);
+    QCOMPARE(book.countOf("Part 50"), 0);
+    book.get(57)->setTitle("Part 50");
+    QCOMPARE(book.countOf("Part 7"), 1);
+    QCOMPARE(book.indexOf("Part 50"), 57);
+    book.get(58)->setAttribute("title", QString("Renamed"));
+    QCOMPARE(book.indexOf("Renamed"), 58);
+    QCOMPARE(book.countOf("Part 8"), 1);
+    book.remove(0);
+    QCOMPARE(book.indexOf("Part 50"), 56);
+    Part part("Part 0"), last("Last");
+    book.put(0, &part);
+    QCOMPARE(book.indexOf("Part 0"), 0);
+    book.add(&last);
+    QCOMPARE(book.indexOf("Last"), 100);
+    QCOMPARE(book.indexOf("Part 50"), 57);      // shifted by put()
+    Part other("Other");
+    book.set(0, &other);
+    QCOMPARE(book.indexOf("Other"), 0);
+    QCOMPARE(book.countOf("Part 0"), 1);
+    book.set(0, &part);
+    part.setTitle("First");
+    QCOMPARE(book.indexOf("First"), 0);
+    QCOMPARE(book.countOf("Part 0"), 1);
+    part.setTitle("Part 0");
+    QCOMPARE(book.countOf("Part 0"), 2);
+    // same results without index
+    book.setTitleIndexEnabled(false);
+    QCOMPARE(book.indexOf("Last"), 100);
+    QCOMPARE(book.countOf("Part 1"), 2);
+    book.removeAt(100);
+    book.removeAt(0);
+}
+
+void TestPart::testSharedTitleIndex()
+{
+    Part part("Part");
+    Part *a = part.newPart("A");
+    part.newPart("B");
+    Part copy(part);
+    part.setTitleIndexEnabled(true);
+    copy.setTitleIndexEnabled(true);
+    QCOMPARE(part.indexOf("A"), 0);
+    QCOMPARE(copy.indexOf("A"), 0);
+
+    // listed by both, indexes of owner and copy are rebuilt
+    a->setTitle("C");
+    QCOMPARE(part.indexOf("C"), 0);
+    QCOMPARE(copy.indexOf("C"), 0);
+    QCOMPARE(copy.indexOf("A"), -1);
+    QCOMPARE(copy.countOf("A"), 0);
+
+    Book book(part);
+    book.setTitleIndexEnabled(true);
+    QCOMPARE(book.countOf("B"), 1);
+    part.get(1)->setTitle("A");
+    QCOMPARE(book.countOf("B"), 0);
+    QCOMPARE(book.indexOf("A"), 1);
+}
+
+void TestPart::testTreeAggregates()
+{
+    Book book("Example", "PW");
+    QCOMPARE(book.depth(), 0);
+    QCOMPARE(book.descendantCount(), 0);
+    Part *p1 = book.newPart("Part 1");
+    Part *p2 = book.newPart("Part 2");
+    QCOMPARE(book.depth(), 1);
+    QCOMPARE(book.descendantCount(), 2);
+    QCOMPARE(p1->owner(), static_cast<Part*>(&book));
+
+    // added deeply after cached
+    Part *p21 = p2->newPart("Part 2.1");
+    p21->newPart("Part 2.1.1");
+    QCOMPARE(book.depth(), 3);
+    QCOMPARE(book.descendantCount(), 4);
+    QCOMPARE(p2->depth(), 2);
+    QCOMPARE(p2->descendantCount(), 2);
+
+    // subtree added at once
+    Part section("Section");
+    section.newPart("Section 1")->newPart("Section 1.1");
+    p1->put(0, &section);
+    QCOMPARE(book.depth(), 4);
+    QCOMPARE(book.descendantCount(), 7);
+
+    p1->remove(0);
+    QVERIFY(section.owner() == 0);
+    QCOMPARE(book.depth(), 3);
+    QCOMPARE(book.descendantCount(), 4);
+
+    Part leaf("Leaf");
+    p2->set(0, &leaf);
+    QCOMPARE(book.depth(), 2);
+    QCOMPARE(book.descendantCount(), 3);
+    QVERIFY(p21->owner() == 0);
+
+    // QList methods keep owner
+    p2->removeAt(0);
+    QVERIFY(leaf.owner() == 0);
+    QCOMPARE(p2->depth(), 0);
+    QCOMPARE(p2->descendantCount(), 0);
+
+    Part loose("Loose");
+    p1->append(&loose);
+    QCOMPARE(loose.owner(), p1);
+    loose.newPart("Loose 1");
+    QCOMPARE(book.depth(), 3);
+    QCOMPARE(book.descendantCount(), 4);
+    QCOMPARE(p1->takeAt(0), &loose);
+    QVERIFY(loose.owner() == 0);
+    QCOMPARE(book.descendantCount(), 2);
+
+    // deleted sub-part leaves the list
+    Part *temp = p1->newPart("Temp");
+    temp->newPart("Temp 1");
+    QCOMPARE(book.depth(), 3);
+    QCOMPARE(book.descendantCount(), 4);
+    delete temp;
+    QVERIFY(p1->isEmpty());
+    QCOMPARE(book.depth(), 1);
+    QCOMPARE(book.descendantCount(), 2);
+
+    // listed twice, counted twice
+    p2->add(&loose);
+    p2->add(&loose);
+    QCOMPARE(book.depth(), 3);
+    QCOMPARE(book.descendantCount(), 6);
+    p2->removeOne(&loose);
+    QCOMPARE(loose.owner(), p2);
+    QCOMPARE(book.descendantCount(), 4);
+    QCOMPARE(p2->removeAll(&loose), 1);
+    QVERIFY(loose.owner() == 0);
+    QCOMPARE(book.depth(), 1);
+
+    // owner deleted before sub-part
+    Part *section2 = new Part("Section 2");
+    section2->add(&leaf);
+    delete section2;
+    QVERIFY(leaf.owner() == 0);
+    leaf.setTitle("Leaf 2");
+}
+
+void TestPart::testSharedTrees()
+{
+    Book book1("Book 1", "PW"), book2("Book 2", "PW");
+    Part *p1 = book1.newPart("Part 1");
+    book2.newPart("Part 1");
+    QCOMPARE(book1.depth(), 1);
+    TocIndex toc(&book1);
+    QCOMPARE(toc.size(), 1);
+
+    // other book changed
+    int revision = book1.treeRevision();
+    book2.newPart("Part 2")->newPart("Part 2.1");
+    book2.remove(0);
+    QCOMPARE(book1.treeRevision(), revision);
+    QVERIFY(! toc.isStale());
+    QCOMPARE(book2.descendantCount(), 2);
+
+    // sub-parts listed by both copies
+    Part copy(book1);
+    QCOMPARE(copy.descendantCount(), 1);
+    p1->newPart("Part 1.1");
+    QVERIFY(book1.treeRevision() != revision);
+    QVERIFY(toc.isStale());
+    QCOMPARE(book1.descendantCount(), 2);
+    QCOMPARE(copy.descendantCount(), 2);
+    QCOMPARE(copy.depth(), 2);
+    copy.clear();
+    QCOMPARE(p1->owner(), static_cast<Part*>(&book1));
+    book1.clear();
+    QVERIFY(p1->owner() == 0);
+}
+
+void TestPart::testTocIndex()
+{
+    Book book("Example", "PW");
+    Part *p1 = book.newPart("Part 1");
+    Part *p11 = p1->newPart("Part 1.1");
+    Part *p12 = p1->newPart("Part 1.2");
+    Part *p2 = book.newPart("Part 2");
+    Part *p3 = book.newPart("Part 3");
+    Part *p31 = p3->newPart("Part 3.1");
+    Part *p311 = p31->newPart("Part 3.1.1");
+
+    TocIndex toc(&book);
+    QVERIFY(toc.isStale());
+    QCOMPARE(toc.size(), 7);
+    QVERIFY(! toc.isStale());
+    QCOMPARE(toc.part(0), p1);
+    QCOMPARE(toc.part(1), p11);
+    QCOMPARE(toc.part(4), p3);
+    QCOMPARE(toc.part(6), p311);
+    QVERIFY(toc.part(7) == 0);
+    QCOMPARE(toc.entry(6).parent, 5);
+    QCOMPARE(toc.entry(6).depth, 2);
+    QCOMPARE(toc.entry(0).end, 3);
+    QCOMPARE(toc.entry(4).end, 7);
+    QCOMPARE(toc.path(6), QList<int>() << 2 << 0 << 0);
+    QCOMPARE(book.findPart(toc.path(6)), p311);
+
+    QCOMPARE(toc.ordinalOf(QList<int>() << 0), 0);
+    QCOMPARE(toc.ordinalOf(QList<int>() << 0 << 1), 2);
+    QCOMPARE(toc.ordinalOf(QList<int>() << 1), 3);
+    QCOMPARE(toc.ordinalOf(QList<int>() << 2 << 0 << 0), 6);
+    QCOMPARE(toc.ordinalOf(QList<int>() << 1 << 0), -1);
+    QCOMPARE(toc.ordinalOf(QList<int>() << 3), -1);
+    QCOMPARE(toc.ordinalOf(p12), 2);
+    QCOMPARE(toc.ordinalOf(&book), -1);
+
+    // leaf parts are chapters
+    QCOMPARE(toc.chapterCount(), 4);
+    QCOMPARE(toc.chapterAt(0), 1);
+    QCOMPARE(toc.chapterAt(2), 3);
+    QCOMPARE(toc.chapterAt(4), -1);
+    QCOMPARE(toc.nextChapter(2), 3);
+    QCOMPARE(toc.nextChapter(3), 6);
+    QCOMPARE(toc.nextChapter(6), -1);
+    QCOMPARE(toc.previousChapter(6), 3);
+    QCOMPARE(toc.previousChapter(1), -1);
+
+    // rebuilt after changes
+    p2->newPart("Part 2.1");
+    QVERIFY(toc.isStale());
+    QCOMPARE(toc.size(), 8);
+    QCOMPARE(toc.ordinalOf(QList<int>() << 1 << 0), 4);
+    QCOMPARE(toc.chapterCount(), 4);
+    p1->remove(0);
+    QCOMPARE(toc.ordinalOf(p12), 1);
+    QCOMPARE(toc.ordinalOf(p11), -1);
+}
+
 void TestPart::getPart()
 {
     Book book("Example", "PW");
@@ -165,3 +409,49 @@ void TestPart::writeText()
     p.writeTo(ts, 4);
     QCOMPARE(buf.data(), QByteArray("ABC\n"));
 }
+
+void TestPart::testSharedContent()
+{
+    Part part("Part", QString("shared text"));
+    part.setAttribute("note", QString("note"));
+    Part copy(part);
+    QVERIFY(copy.source().raw().constData() == part.source().raw().constData());
+    QVERIFY(copy.attribute("note").toString().constData() ==
+            part.attribute("note").toString().constData());
+    QVERIFY(copy.source() == part.source());
+    QVERIFY(! (copy == part));  // different parts
+
+    // detached on write
+    copy.setText("changed");
+    QCOMPARE(part.text(), QString("shared text"));
+    Part other("Other");
+    other = part;
+    QVERIFY(other.source().raw().constData() == part.source().raw().constData());
+}
+
+void TestPart::testStats()
+{
+    Book book("Example", "PW");
+    book.newPart("Part 1", "Hello world");
+    Part *p = book.newPart("Part 2", "ABC\nDEF");
+    TextStats stats = book.stats();
+    QCOMPARE(stats.chars, qint64(18));
+    QCOMPARE(stats.lines, qint64(3));
+    QCOMPARE(stats.words, qint64(4));
+    p->setText("ABC");
+    stats = book.stats();
+    QCOMPARE(stats.chars, qint64(14));
+    QCOMPARE(stats.lines, qint64(2));
+    QCOMPARE(stats.words, qint64(3));
+
+    // cached sums are dropped by changes deeper in the tree
+    Part *p21 = p->newPart("Part 2.1", "Hi");
+    QCOMPARE(book.stats().chars, qint64(13));
+    QCOMPARE(book.stats().words, qint64(3));
+    p21->setText("Hi there");
+    QCOMPARE(p->stats().words, qint64(2));
+    QCOMPARE(book.stats().chars, qint64(19));
+    QCOMPARE(book.stats().words, qint64(4));
+    p->remove(0);
+    QCOMPARE(book.stats().chars, qint64(14));
+}
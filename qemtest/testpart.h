@@ -35,9 +35,16 @@ private slots:
     void addPart();
     void removePart();
     void indexPart();
+    void testTitleIndex();
+    void testSharedTitleIndex();
+    void testTreeAggregates();
+    void testSharedTrees();
+    void testTocIndex();
     void getPart();
     void modifyContent();
     void writeText();
+    void testStats();
+    void testSharedContent();
 
 };
 
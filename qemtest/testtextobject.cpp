@@ -19,9 +19,14 @@
 #include "testtextobject.h"
 #include <textobject.h>
 #include <filefactory.h>
+#include <fileutils.h>
+#include <contentcache.h>
+#include <linereader.h>
 #include <QDir>
 #include <QFile>
 #include <QBuffer>
+#include <QTextCodec>
+#include <QTemporaryFile>
 #include <QTextStream>
 
 QEM_USE_NAMESPACE
@@ -68,6 +73,58 @@ void TestTextObject::setFile()
     QDir().remove("tmp.txt");
 }
 
+void TestTextObject::testShared()
+{
+    TextObject a("shared");
+    TextObject b(a);
+    QVERIFY(a == b);
+    QVERIFY(a.raw().constData() == b.raw().constData());
+    b.setRaw("detached");
+    QCOMPARE(a.text(), QString("shared"));
+    QCOMPARE(b.text(), QString("detached"));
+    TextObject c;
+    c = a;
+    QCOMPARE(c.text(), QString("shared"));
+    c = b;
+    QCOMPARE(c.text(), QString("detached"));
+    QCOMPARE(a.text(), QString("shared"));
+    // through QVariant
+    const QVariant &v = QVariant::fromValue(a);
+    QCOMPARE(TextObject::fromQVariant(v).raw().constData(), a.raw().constData());
+}
+
+void TestTextObject::testFingerprint()
+{
+    TextObject a("same text"), b(QString("same ") + "text"), c("other text");
+    QCOMPARE(a.fingerprint(), b.fingerprint());
+    QVERIFY(a.fingerprint() != c.fingerprint());
+    QVERIFY(a == b);
+    QVERIFY(!(a == c));
+    QCOMPARE(FileUtils::fingerprint(FileUtils::fingerprint(QString("same ")), QString("text")),
+             a.fingerprint());
+    // different files with same content
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("same text");
+    file.close();
+    QVERIFY(QFile::copy("tmp.txt", "tmp2.txt"));
+    FileObject *f1 = FileFactory::getFile("tmp.txt");
+    FileObject *f2 = FileFactory::getFile("tmp2.txt");
+    QVERIFY(f1 != 0 && f2 != 0);
+    QVERIFY(FileUtils::sameContent(*f1, *f2));
+    TextObject t1(f1), t2(f2);
+    QVERIFY(t1 == t2);
+    QVERIFY(t1 == a);
+    quint64 loaded = t1.fingerprint();
+    t1.setRaw("changed");
+    QVERIFY(t1.fingerprint() != loaded);
+    QVERIFY(!(t1 == t2));
+    delete f1;
+    delete f2;
+    QDir().remove("tmp.txt");
+    QDir().remove("tmp2.txt");
+}
+
 void TestTextObject::testWrite()
 {
     TextObject to("Hello world!");
@@ -91,3 +148,314 @@ void TestTextObject::testWrite()
     buf.seek(0);
     QCOMPARE(ts.readAll(), QString("Hello world!"));
 }
+
+void TestTextObject::testPreview()
+{
+    QCOMPARE(TextObject("Hello world!").preview(5), QString("Hello"));
+    QCOMPARE(TextObject("Hello").preview(10), QString("Hello"));
+    QCOMPARE(TextObject("Hello").preview(0), QString());
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(QByteArray("preview ").repeated(10000));
+    file.close();
+    FileObject *fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    TextObject to(fb);
+    QCOMPARE(to.preview(15), QString("preview preview"));
+    QCOMPARE(to.preview(100000).size(), 80000);
+    delete fb;
+    QDir().remove("tmp.txt");
+}
+
+void TestTextObject::testPassThrough()
+{
+    const QString text = QString::fromUtf8("pass \xe4\xb8\xad\xe6\x96\x87 through");
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("\xef\xbb\xbf");    // BOM
+    file.write(text.toUtf8());
+    file.close();
+    FileObject *fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    TextObject to(fb, "UTF-8");
+    QBuffer buffer;
+    QVERIFY(buffer.open(QBuffer::ReadWrite));
+    QCOMPARE(to.writeTo(buffer, "UTF-8"), qint64(text.size()));
+    QCOMPARE(buffer.data(), text.toUtf8());
+    delete fb;
+
+    QTextCodec *codec = QTextCodec::codecForName("UTF-16LE");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(codec->fromUnicode(text));    // with BOM
+    file.close();
+    fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    to.setFile(fb, "UTF-16LE");
+    buffer.buffer().clear();
+    buffer.seek(0);
+    QCOMPARE(to.writeTo(buffer, "UTF-16LE", 5), qint64(5));
+    QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+    QCOMPARE(buffer.data(), codec->fromUnicode(text.constData(), 5, &state));
+    // different codec is transcoded
+    buffer.buffer().clear();
+    buffer.seek(0);
+    to.writeTo(buffer, "UTF-8");
+    QCOMPARE(buffer.data(), text.toUtf8());
+    delete fb;
+    QDir().remove("tmp.txt");
+}
+
+void TestTextObject::testCodecForName()
+{
+    QTextCodec *codec = FileUtils::codecForName("UTF-8");
+    QVERIFY(codec != 0);
+    QCOMPARE(codec, QTextCodec::codecForName("UTF-8"));
+    QCOMPARE(FileUtils::codecForName("UTF-8"), codec);
+    QVERIFY(FileUtils::codecForName(QByteArray()) == 0);
+    QVERIFY(FileUtils::codecForName("no-such-codec") == 0);
+    QVERIFY(FileUtils::codecForName("no-such-codec") == 0);
+}
+
+void TestTextObject::testMappedText()
+{
+    const QString head("head"), text("mapped chapter text");
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QTextStream out(&file);
+    out.setCodec("UTF-16LE");
+    out << head << text;
+    out.flush();
+    FileObject *fb = FileFactory::getFile("chapter", &file, head.size() * 2, text.size() * 2);
+    QVERIFY(fb != 0);
+    const char *data = fb->mappedData();
+    QVERIFY(data != 0);
+    TextObject to(fb, "UTF-16LE");
+    const QString &view = to.textView();
+    QCOMPARE(view, text);
+    // no copy and decoding
+    QVERIFY(reinterpret_cast<const char*>(view.constData()) == data);
+    // text() owns its data
+    const QString &s = to.text();
+    QCOMPARE(s, text);
+    QVERIFY(reinterpret_cast<const char*>(s.constData()) != data);
+    QCOMPARE(to.preview(6), QString("mapped"));
+    QCOMPARE(to.preview(100), text);
+    // areas of same file share mapping
+    FileObject *other = FileFactory::getFile("head", &file, 0, head.size() * 2);
+    QVERIFY(other != 0);
+    QVERIFY(other->mappedData() + head.size() * 2 == data);
+    // lines read from the mapping own their data
+    TextObject mapped(fb, "UTF-16LE");
+    LineReader *reader = mapped.lineReader();
+    QString line;
+    QVERIFY(reader->readLine(line));
+    delete reader;
+    QCOMPARE(line, text);
+    QVERIFY(reinterpret_cast<const char*>(line.constData()) != data);
+    delete other;
+    delete fb;
+    QCOMPARE(s, text);      // still valid without the mapping
+}
+
+void TestTextObject::testCache()
+{
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("cached text");
+    file.close();
+    ContentCache cache(1024);
+    FileObject *fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    fb->setCache(&cache);
+    TextObject to(fb);
+    QCOMPARE(to.text(), QString("cached text"));
+    QCOMPARE(cache.misses(), quint64(1));
+    QCOMPARE(TextObject(fb).text(), QString("cached text"));
+    QCOMPARE(cache.hits(), quint64(1));
+    QCOMPARE(to.text(), QString("cached text"));
+    QCOMPARE(cache.hits(), quint64(2));     // not kept again by the TextObject
+    QCOMPARE(TextObject::cachedBytes(), 0);
+    QCOMPARE(cache.totalBytes(), qint64(22));
+    cache.setMaxBytes(10);      // evicted
+    QCOMPARE(cache.totalBytes(), qint64(0));
+    cache.setMaxBytes(1024);
+    QCOMPARE(to.text(), QString("cached text"));
+    delete fb;      // removes its text
+    QCOMPARE(cache.totalBytes(), qint64(0));
+    QDir().remove("tmp.txt");
+}
+
+void TestTextObject::testDecodedText()
+{
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("decoded");
+    file.close();
+    FileObject *fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    int base = TextObject::cachedBytes();
+    int budget = TextObject::cacheBudget();
+    QCOMPARE(budget, 0);    // disabled by default
+    TextObject::setCacheBudget(1024);
+    TextObject to(fb);
+    QCOMPARE(to.text(), QString("decoded"));
+    QCOMPARE(TextObject::cachedBytes(), base + 14);
+    {
+        TextObject copy(to);    // shares decoded text
+        QCOMPARE(copy.text(), QString("decoded"));
+    }
+    QCOMPARE(TextObject::cachedBytes(), base + 14);
+
+    // least recently used text is released for new text
+    QFile file2("tmp2.txt");
+    QVERIFY(file2.open(QFile::WriteOnly));
+    file2.write("another");
+    file2.close();
+    FileObject *fb2 = FileFactory::getFile("tmp2.txt");
+    QVERIFY(fb2 != 0);
+    TextObject::setCacheBudget(20);
+    {
+        TextObject other(fb2);
+        QCOMPARE(other.text(), QString("another"));
+        QCOMPARE(TextObject::cachedBytes(), base + 14);
+        QCOMPARE(to.text(), QString("decoded"));
+        QCOMPARE(TextObject::cachedBytes(), base + 14);
+        TextObject::setCacheBudget(0);
+        QCOMPARE(TextObject::cachedBytes(), base);
+    }
+    delete fb2;
+    QDir().remove("tmp2.txt");
+    TextObject::setCacheBudget(1024);
+    QCOMPARE(to.text(), QString("decoded"));
+    QCOMPARE(TextObject::cachedBytes(), base + 14);
+    to.setRaw("raw");
+    QCOMPARE(TextObject::cachedBytes(), base);
+    TextObject::setCacheBudget(0);
+    to.setFile(fb);
+    QCOMPARE(to.text(), QString("decoded"));
+    QCOMPARE(TextObject::cachedBytes(), base);
+    TextObject::setCacheBudget(budget);
+    delete fb;
+    QDir().remove("tmp.txt");
+}
+
+static QStringList regExpLines(const QString &s, bool skipEmptyLine)
+{
+    return s.split(QRegExp("(\\r\\n|\\r|\\n)"),
+                   skipEmptyLine ? QString::SkipEmptyParts : QString::KeepEmptyParts);
+}
+
+void TestTextObject::testLines()
+{
+    QStringList samples;
+    samples << "" << "\n" << "\r\n" << "\n\r" << "a" << "a\r" << "\r\r\n\n"
+            << "0123456789abcdef\r\n0123456789\rabcdef\n\n"
+            << QString("long line without break ").repeated(10);
+    foreach (const QString &s, samples) {
+        QCOMPARE(TextObject(s).lines(false), regExpLines(s, false));
+        QCOMPARE(TextObject(s).lines(true), regExpLines(s, true));
+    }
+}
+
+static QStringList readLines(LineReader *reader)
+{
+    QStringList lines;
+    QString line;
+    while (reader->readLine(line)) {
+        lines << line;
+    }
+    delete reader;
+    return lines;
+}
+
+void TestTextObject::testStats()
+{
+    TextStats stats = TextObject(QString::fromUtf8("Hello, world!\r\n\xe4\xb8\xad\xe6\x96\x87 text\r")).stats();
+    QCOMPARE(stats.chars, qint64(23));
+    QCOMPARE(stats.lines, qint64(3));
+    QCOMPARE(stats.words, qint64(5));
+    QCOMPARE(stats.bytes, qint64(46));
+    stats = TextObject().stats();
+    QCOMPARE(stats.chars, qint64(0));
+    QCOMPARE(stats.lines, qint64(1));
+    QCOMPARE(stats.words, qint64(0));
+
+    // CR LF across chunks of file
+    QString text;
+    for (int i = 0; i < 30000; ++i) {
+        text += (i % 2 == 0) ? "word\r\n" : "x\n";
+    }
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(text.toLatin1());
+    file.close();
+    FileObject *fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    TextObject to(fb, "ISO-8859-1");
+    stats = to.stats();
+    QCOMPARE(stats.chars, qint64(text.size()));
+    QCOMPARE(stats.lines, qint64(regExpLines(text, false).size()));
+    QCOMPARE(stats.words, qint64(30000));
+    QCOMPARE(stats.bytes, qint64(text.size()));
+    to.setRaw("a b");
+    QCOMPARE(to.stats().words, qint64(2));
+    delete fb;
+    QDir().remove("tmp.txt");
+}
+
+void TestTextObject::testLineReader()
+{
+    QStringList samples;
+    samples << "" << "\n" << "\r\n" << "a\r" << "\r\r\n\n"
+            << "0123456789abcdef\r\n0123456789\rabcdef\n\n";
+    foreach (const QString &s, samples) {
+        QCOMPARE(readLines(TextObject(s).lineReader(false)), regExpLines(s, false));
+        QCOMPARE(readLines(TextObject(s).lineReader(true)), regExpLines(s, true));
+    }
+    // CR LF across chunks of file
+    QString text;
+    for (int i = 0; i < 3000; ++i) {
+        text += QString::number(i);
+        text += (i % 2 == 0) ? "\r\n" : "\n\n";
+    }
+    QFile file("tmp.txt");
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(text.toUtf8());
+    file.close();
+    FileObject *fb = FileFactory::getFile("tmp.txt");
+    QVERIFY(fb != 0);
+    QCOMPARE(readLines(TextObject(fb, "UTF-8").lineReader(false)), regExpLines(text, false));
+    QCOMPARE(readLines(TextObject(fb, "UTF-8").lineReader(true)), regExpLines(text, true));
+    delete fb;
+    QDir().remove("tmp.txt");
+}
+
+void TestTextObject::benchmarkLines_data()
+{
+    QTest::addColumn<bool>("regExp");
+    QTest::newRow("splitter") << false;
+    QTest::newRow("QRegExp") << true;
+}
+
+void TestTextObject::benchmarkLines()
+{
+    QFETCH(bool, regExp);
+    const QString line("A line of a chapter in the book, long enough for a paragraph.");
+    QString text;
+    for (int i = 0; i < 20000; ++i) {
+        text += line;
+        text += (i % 3 == 0) ? "\r\n" : "\n";
+    }
+    TextObject to(text);
+    QStringList lines;
+    if (regExp) {
+        QBENCHMARK {
+            lines = regExpLines(text, false);
+        }
+    } else {
+        QBENCHMARK {
+            lines = to.lines(false);
+        }
+    }
+    QCOMPARE(lines.size(), 20001);
+}
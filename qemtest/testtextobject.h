@@ -28,7 +28,20 @@ private slots:
     void newTextObject();
     void setText();
     void setFile();
+    void testShared();
+    void testFingerprint();
     void testWrite();
+    void testPreview();
+    void testPassThrough();
+    void testCodecForName();
+    void testMappedText();
+    void testCache();
+    void testDecodedText();
+    void testLines();
+    void testStats();
+    void testLineReader();
+    void benchmarkLines_data();
+    void benchmarkLines();
 };
 
 #endif // TESTTEXTOBJECT_H
@@ -24,6 +24,8 @@
 #include <QRegExp>
 #include <QFile>
 #include <QDir>
+#include <QHash>
+#include <QPair>
 #include <qem.h>
 #include <fileutils.h>
 #include <filefactory.h>
@@ -43,7 +45,7 @@ static QTextStream& printError(const QString &s)
 
 static const QString ORDER_SEPARATOR("$");
 
-static const QString OPTIONS("hvluf:o:c:p:j:V:P:M:S:");
+static const QString OPTIONS("hvludf:o:c:p:j:V:P:M:S:");
 
 static QVariantMap parseValues(const QStringList &values)
 {
@@ -72,6 +74,7 @@ static void showHelp()
     cout << QObject::tr("Usage: %1 [options] files...").arg(QFileInfo(QCoreApplication::arguments()[0]).fileName()) << endl;
     cout << QObject::tr("Options:") << endl;
     cout << QString(" -c %1").arg(QObject::tr("<format>"), -20) << QObject::tr("Convert file to specified format") << endl;
+    cout << QString(" -d %1").arg("", -20) << QObject::tr("Warn duplicate chapters when joining files") << endl;
     cout << QString(" -f %1").arg(QObject::tr("<format>"), -20) << QObject::tr("Specify format of input file") << endl;
     cout << QString(" -h %1").arg("", -20) << QObject::tr("Print help message") << endl;
     cout << QString(" -j %1").arg(QObject::tr("<format>"), -20) << QObject::tr("Join input files to one file named name") << endl;
@@ -87,6 +90,8 @@ static void showHelp()
     cout << QString("    %1").arg("", -18) << QString("all:    ") << QObject::tr("Print all properties(default)") << endl;
     cout << QString("    %1").arg("", -18) << QString("all_names:    ") << QObject::tr("Print available names") << endl;
     cout << QString("    %1").arg("", -18) << QString("items:    ") << QObject::tr("Print all items of book") << endl;
+    cout << QString("    %1").arg("", -18) << QString("preview:    ") << QObject::tr("Print leading text of chapter") << endl;
+    cout << QString("    %1").arg("", -18) << QString("stats:    ") << QObject::tr("Print characters, lines, words and bytes") << endl;
     cout << QString("    %1").arg("", -18) << QString("toc:    ") << QObject::tr("Print tree of TOC (table of contents)") << endl;
     cout << QString("    %1").arg("", -18) << QString("chapterN.N..N%1name:    ").arg(ORDER_SEPARATOR) <<
             QObject::tr("Print chapter properties") << endl;
@@ -125,6 +130,9 @@ static void showSupported()
 
 static const QString DEFALUT_NAME("text");
 
+// characters printed by preview view
+static const int PREVIEW_SIZE = 200;
+
 typedef QMap<QString, QString> StringMap;
 static void setProperties(Book *book, const QVariantMap &properties)
 {
@@ -263,18 +271,33 @@ static void viewProperty(const Part &part, const QString &key)
         } else {
             cout << part.content() << endl;
         }
+    } else if (key == "preview") {
+        if (part.isSection()) {
+            printError(QObject::tr("Given chapter is section:")) << part.title() << endl;
+        } else {
+            cout << part.preview(PREVIEW_SIZE) << endl;
+        }
     } else if (key == "all_names") {
         cout << part.title() << ": " << QStringList(part.attributeNames()).join(", ") << endl;
     } else if (key == "all") {
         Qem::printProperties(part, "\n", part.attributeNames(), false, &cout);
     } else if (key == "size") {
         cout << key << "=" << part.size() << endl;
+    } else if (key == "stats") {
+        const TextStats &stats = part.stats();
+        cout << "chars=" << stats.chars << ", lines=" << stats.lines << ", words=" << stats.words <<
+                ", bytes=" << stats.bytes << endl;
     } else if (key == "items") {
         const Book &book = (Book&) part;
         foreach (const QString &name, book.itemNames()) {
             const QVariant &value = book.getItem(name);
             cout << "Item: name=\"" << name << "\", type=\"" << Qem::variantType(value) <<
-                    "\", value=\"" << Qem::formatVariant(value) << "\"" << endl;
+                    "\", value=\"" << Qem::formatVariant(value) << "\"";
+            FileObject *file = FileObject::fromQVariant(value);
+            if (file != 0 && file->available() >= 0) {
+                cout << ", bytes=\"" << file->available() << "\"";
+            }
+            cout << endl;
         }
     } else {
         cout << key << "=" << Qem::formatVariant(part.attribute(key)) << endl;
@@ -338,9 +361,35 @@ static void viewBook(QFile &file, const QString &inFormat, QStringList names, co
     delete book;
 }
 
+typedef QPair<const Part*, QString> ChapterPath;
+
+/// Warns chapters of \a part with same content as another joined chapter.
+/** Chapters of same fingerprint are confirmed by TextObject::operator==(), empty chapters are skipped. */
+static void checkDuplicates(const Part &part, const QString &path, QMultiHash<quint64, ChapterPath> &seen)
+{
+    if (! part.isSection()) {
+        if (part.preview(1).isEmpty()) {
+            return;
+        }
+        quint64 hash = part.fingerprint();
+        foreach (const ChapterPath &other, seen.values(hash)) {
+            if (other.first->source() == part.source()) {
+                printError(QObject::tr("Duplicate chapter: ")) << path << QObject::tr(", same as ") <<
+                                                                  other.second << endl;
+                return;
+            }
+        }
+        seen.insert(hash, ChapterPath(&part, path));
+        return;
+    }
+    foreach (const Part *sub, part) {
+        checkDuplicates(*sub, path + "/" + sub->title(), seen);
+    }
+}
+
 static void joinBook(const QList<QString> &files, const QVariantMap &inArgs,
                      const QVariantMap &properties,const QString &output,
-                     const QString &outFormat, const QVariantMap &outArgs)
+                     const QString &outFormat, const QVariantMap &outArgs, bool warnDuplicates)
 {
     Book book;
     setProperties(&book, properties);
@@ -349,13 +398,20 @@ static void joinBook(const QList<QString> &files, const QVariantMap &inArgs,
         QFile *file = new QFile(name, &book);
         Book *sub = openBook(*file, QString(), inArgs, QVariantMap());
         if (sub != 0) {
-            book.append(sub);
+            book.add(sub);
             opened.append(sub);
         }
     }
+    if (warnDuplicates) {
+        QMultiHash<quint64, ChapterPath> seen;
+        foreach (const Book *sub, opened) {
+            checkDuplicates(*sub, sub->title(), seen);
+        }
+    }
     QString name;
     bool ret = saveBook(book, output, outFormat, outArgs, &name);
-    // destroy all opened sub-books
+    // destroy all opened sub-books, book does not own them
+    book.clear();
     foreach (Book *sub, opened) {
         delete sub;
     }
@@ -386,6 +442,7 @@ int main(int argc, char *argv[])
     QString output(".");
     QStringList viewNames;
     viewNames << "all";
+    bool warnDuplicates = false;
 
     ArgumentMap am;
     if (! parseArguments(app.arguments(), OPTIONS, am, &cerr, app.applicationName()+": ")) {
@@ -420,6 +477,11 @@ int main(int argc, char *argv[])
             cmd = Convert;
         }
             break;
+        case 'd':
+        {
+            warnDuplicates = true;
+        }
+            break;
         case 'f':
         {
             inFormat = values.last().toLower();
@@ -490,7 +552,7 @@ int main(int argc, char *argv[])
         return 0;
     }
     if (Join == cmd) {
-        joinBook(files, inArgs, bookProperties, output, outFormat, outArgs);
+        joinBook(files, inArgs, bookProperties, output, outFormat, outArgs, warnDuplicates);
         return 0;
     }
     foreach (const QString &name, files) {